@@ -0,0 +1,267 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Curvessor.
+
+Curvessor is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Curvessor is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Curvessor.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Built only with the CURVESSOR_DETECT_ALLOCATIONS CMake option, see
+// AllocationCheck.h. The replaced operators go straight to the allocator of
+// the C library, uncounted, so the checks themselves never allocate and an
+// operator new is not counted again by the replaced malloc.
+
+#include "AllocationCheck.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <new>
+
+#if CURVESSOR_DETECT_ALLOCATIONS
+
+#ifdef __GLIBC__
+// the glibc implementations of the functions replaced below
+extern "C" {
+void*
+__libc_malloc(std::size_t size);
+void*
+__libc_calloc(std::size_t count, std::size_t size);
+void*
+__libc_realloc(void* memory, std::size_t size);
+void*
+__libc_memalign(std::size_t alignment, std::size_t size);
+void*
+__libc_valloc(std::size_t size);
+}
+// read by malloc, so they must not need an allocation on first use, as
+// dynamic TLS does in a shared library
+#define CURVESSOR_ALLOCATION_TLS __attribute__((tls_model("initial-exec")))
+#else
+#define CURVESSOR_ALLOCATION_TLS
+#endif
+
+namespace {
+
+CURVESSOR_ALLOCATION_TLS thread_local int checkDepth = 0;
+CURVESSOR_ALLOCATION_TLS thread_local int numAllocationsInCheck = 0;
+
+std::atomic<uint64_t> numDetectedAllocations{ 0 };
+
+inline void
+countAllocation()
+{
+  if (checkDepth > 0) {
+    ++numAllocationsInCheck;
+  }
+}
+
+void*
+allocate(std::size_t size)
+{
+  countAllocation();
+  size = size == 0 ? 1 : size;
+#ifdef __GLIBC__
+  void* const memory = __libc_malloc(size);
+#else
+  void* const memory = std::malloc(size);
+#endif
+  if (memory) {
+    return memory;
+  }
+  throw std::bad_alloc();
+}
+
+void*
+allocateAligned(std::size_t size, std::align_val_t alignment)
+{
+  countAllocation();
+  auto const align = static_cast<std::size_t>(alignment);
+  // aligned_alloc wants a multiple of the alignment
+  size = ((size == 0 ? 1 : size) + align - 1) & ~(align - 1);
+#if defined(_WIN32)
+  void* const memory = _aligned_malloc(size, align);
+#elif defined(__GLIBC__)
+  void* const memory = __libc_memalign(align, size);
+#else
+  void* const memory = std::aligned_alloc(align, size);
+#endif
+  if (memory) {
+    return memory;
+  }
+  throw std::bad_alloc();
+}
+
+void
+freeAligned(void* memory) noexcept
+{
+#ifdef _WIN32
+  _aligned_free(memory);
+#else
+  std::free(memory);
+#endif
+}
+
+} // namespace
+
+namespace curvessor {
+
+void
+beginAllocationCheck()
+{
+  if (checkDepth++ == 0) {
+    numAllocationsInCheck = 0;
+  }
+}
+
+int
+endAllocationCheck()
+{
+  int const numAllocations = numAllocationsInCheck;
+  if (--checkDepth == 0 && numAllocations > 0) {
+    numDetectedAllocations.fetch_add(numAllocations,
+                                     std::memory_order_relaxed);
+  }
+  return numAllocations;
+}
+
+uint64_t
+getNumDetectedAllocations()
+{
+  return numDetectedAllocations.load(std::memory_order_relaxed);
+}
+
+} // namespace curvessor
+
+// the nothrow versions of new and the sized versions of delete forward to
+// these by default
+
+void*
+operator new(std::size_t size)
+{
+  return allocate(size);
+}
+
+void*
+operator new[](std::size_t size)
+{
+  return allocate(size);
+}
+
+void
+operator delete(void* memory) noexcept
+{
+  std::free(memory);
+}
+
+void
+operator delete[](void* memory) noexcept
+{
+  std::free(memory);
+}
+
+void*
+operator new(std::size_t size, std::align_val_t alignment)
+{
+  return allocateAligned(size, alignment);
+}
+
+void*
+operator new[](std::size_t size, std::align_val_t alignment)
+{
+  return allocateAligned(size, alignment);
+}
+
+void
+operator delete(void* memory, std::align_val_t) noexcept
+{
+  freeAligned(memory);
+}
+
+void
+operator delete[](void* memory, std::align_val_t) noexcept
+{
+  freeAligned(memory);
+}
+
+#ifdef __GLIBC__
+
+// The C allocation functions, used by the JUCE buffers and by most libraries.
+// free is left to glibc, as all of these end up in its allocator.
+
+extern "C" {
+
+void*
+malloc(std::size_t size) noexcept
+{
+  countAllocation();
+  return __libc_malloc(size);
+}
+
+void*
+calloc(std::size_t count, std::size_t size) noexcept
+{
+  countAllocation();
+  return __libc_calloc(count, size);
+}
+
+void*
+realloc(void* memory, std::size_t size) noexcept
+{
+  countAllocation();
+  return __libc_realloc(memory, size);
+}
+
+void*
+memalign(std::size_t alignment, std::size_t size) noexcept
+{
+  countAllocation();
+  return __libc_memalign(alignment, size);
+}
+
+void*
+aligned_alloc(std::size_t alignment, std::size_t size) noexcept
+{
+  countAllocation();
+  return __libc_memalign(alignment, size);
+}
+
+void*
+valloc(std::size_t size) noexcept
+{
+  countAllocation();
+  return __libc_valloc(size);
+}
+
+int
+posix_memalign(void** memory, std::size_t alignment, std::size_t size) noexcept
+{
+  countAllocation();
+  bool const isPowerOfTwo = (alignment & (alignment - 1)) == 0;
+  if (alignment % sizeof(void*) != 0 || !isPowerOfTwo) {
+    return EINVAL;
+  }
+  void* const aligned = __libc_memalign(alignment, size);
+  if (!aligned) {
+    return ENOMEM;
+  }
+  *memory = aligned;
+  return 0;
+}
+
+} // extern "C"
+
+#endif
+
+#endif
@@ -0,0 +1,95 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Curvessor.
+
+Curvessor is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Curvessor is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Curvessor.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// Detection of heap allocations on the audio thread, enabled with the
+// CURVESSOR_DETECT_ALLOCATIONS CMake option, which also builds
+// AllocationCheck.cpp: it replaces the global operator new and delete with
+// versions counting, per thread, the allocations made while a
+// ScopedAllocationCheck is alive. The check asserts that there were none when
+// it goes out of scope, and adds them to a process wide total. When the
+// option is disabled, ScopedAllocationCheck is empty.
+//
+// Only with glibc are malloc, calloc, realloc and the aligned allocation
+// functions replaced as well. Elsewhere the allocations that do not go
+// through operator new, as those of the JUCE AudioBuffer and HeapBlock, are
+// not seen, so a clean run there says nothing about them.
+//
+// The replacement is process wide in the standalone app, while in a plugin it
+// only sees the allocations of the plugin binary on some platforms, so use
+// the standalone app, in a debug build on Linux, to check the processing.
+
+#include <cassert>
+#include <cstdint>
+
+#ifndef CURVESSOR_DETECT_ALLOCATIONS
+#define CURVESSOR_DETECT_ALLOCATIONS 0
+#endif
+
+namespace curvessor {
+
+#if CURVESSOR_DETECT_ALLOCATIONS
+
+void
+beginAllocationCheck();
+
+// returns the number of allocations since the matching beginAllocationCheck
+int
+endAllocationCheck();
+
+// allocations detected by all the checks so far
+uint64_t
+getNumDetectedAllocations();
+
+class ScopedAllocationCheck final
+{
+public:
+  static constexpr bool isEnabled = true;
+
+  ScopedAllocationCheck() { beginAllocationCheck(); }
+
+  ~ScopedAllocationCheck()
+  {
+    int const numAllocations = endAllocationCheck();
+    assert(numAllocations == 0 && "heap allocation on the audio thread");
+    (void)numAllocations;
+  }
+
+  ScopedAllocationCheck(ScopedAllocationCheck const&) = delete;
+  ScopedAllocationCheck& operator=(ScopedAllocationCheck const&) = delete;
+};
+
+#else
+
+class ScopedAllocationCheck final
+{
+public:
+  static constexpr bool isEnabled = false;
+};
+
+inline uint64_t
+getNumDetectedAllocations()
+{
+  return 0;
+}
+
+#endif
+
+} // namespace curvessor
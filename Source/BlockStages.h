@@ -0,0 +1,309 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Curvessor.
+
+Curvessor is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Curvessor is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Curvessor.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// The element-wise stages around the oversamplers, each fused into a single
+// pass over the block. JUCE-free, like CurvessorDsp.h, so that the benchmark
+// runs the same code as Processing.cpp. Include after the SIMD types (as
+// CurvessorDsp.h or avec do).
+//
+// - prepareInput reads the host buffer, converting it to the precision of the
+//   chain, mid side encodes it, copies the dry signal and applies the input
+//   gain, writing the planar input of the oversamplers.
+// - OutputStage reads the interleaved output of the wet oversampler, which is
+//   never deinterleaved on its own, and mixes it with the dry signal, applies
+//   the output gain and the idle cross-fade, mid side decodes it and writes
+//   the host buffer, converting it back to the host precision.
+
+#include <algorithm>
+#include <type_traits>
+
+namespace curvessor {
+
+// SIMD vector running along the samples of a planar channel
+
+template<class Float>
+using SampleVec =
+  std::conditional_t<std::is_same_v<Float, double>, Vec4d, Vec8f>;
+
+template<class V, class Source>
+inline V
+loadAs(Source const* source)
+{
+  using Float = std::remove_cvref_t<decltype(std::declval<V const&>()[0])>;
+  if constexpr (std::is_same_v<Source, Float>) {
+    return V().load(source);
+  }
+  else {
+    Float converted[V::size()];
+    for (int k = 0; k < V::size(); ++k) {
+      converted[k] = static_cast<Float>(source[k]);
+    }
+    return V().load(converted);
+  }
+}
+
+// A one pole smoother from state to target, evaluated in closed form:
+// target + (state - target) * alpha^k at the k-th sample. Consecutive samples
+// only depend on the distance to the target at the start of the vector, so
+// the ramp fills a SampleVec at a time.
+
+template<class Float>
+class GainRamp final
+{
+public:
+  using V = SampleVec<Float>;
+  static constexpr int width = V::size();
+
+  GainRamp(Float const target_, Float const state, Float const alpha_)
+    : target(target_)
+    , distance(state - target_)
+    , alpha(alpha_)
+  {
+    Float powers[width];
+    Float power = 1;
+    for (int k = 0; k < width; ++k) {
+      power *= alpha;
+      powers[k] = power;
+    }
+    alphaPowers.load(powers);
+    alphaToWidth = power;
+  }
+
+  V next()
+  {
+    V const gain = target + distance * alphaPowers;
+    distance *= alphaToWidth;
+    return gain;
+  }
+
+  Float nextScalar()
+  {
+    distance *= alpha;
+    return target + distance;
+  }
+
+  Float getState() const { return target + distance; }
+
+private:
+  Float target;
+  Float distance;
+  Float alpha;
+  Float alphaToWidth;
+  V alphaPowers;
+};
+
+// One pass over the input of a chain: mid side encoding of a stereo pair, the
+// copy of the (encoded) dry signal, unless dry is null, and the smoothed input
+// gain, unless isGainApplied is false. input and io may be the same buffers.
+
+template<class HostFloat, class Float>
+inline void
+prepareInput(HostFloat const* const* input,
+             Float* const* io,
+             Float* const* dry,
+             int const numChannels,
+             int const n,
+             bool const isMidSide,
+             bool const isGainApplied,
+             Float const* gainTarget,
+             Float* gainState,
+             Float const alpha)
+{
+  using V = SampleVec<Float>;
+  constexpr int width = V::size();
+  int const vectorEnd = n - n % width;
+  auto const half = Float(0.5);
+
+  auto const makeRamp = [&](int const c) {
+    if (isGainApplied) {
+      return GainRamp<Float>(gainTarget[c], gainState[c], alpha);
+    }
+    return GainRamp<Float>(1, 1, 0);
+  };
+
+  if (isMidSide) {
+    auto midGain = makeRamp(0);
+    auto sideGain = makeRamp(1);
+    int i = 0;
+    for (; i < vectorEnd; i += width) {
+      V const left = loadAs<V>(input[0] + i);
+      V const right = loadAs<V>(input[1] + i);
+      V const mid = half * (left + right);
+      V const side = half * (left - right);
+      if (dry) {
+        mid.store(dry[0] + i);
+        side.store(dry[1] + i);
+      }
+      (mid * midGain.next()).store(io[0] + i);
+      (side * sideGain.next()).store(io[1] + i);
+    }
+    for (; i < n; ++i) {
+      Float const left = input[0][i];
+      Float const right = input[1][i];
+      Float const mid = half * (left + right);
+      Float const side = half * (left - right);
+      if (dry) {
+        dry[0][i] = mid;
+        dry[1][i] = side;
+      }
+      io[0][i] = mid * midGain.nextScalar();
+      io[1][i] = side * sideGain.nextScalar();
+    }
+    if (isGainApplied) {
+      gainState[0] = midGain.getState();
+      gainState[1] = sideGain.getState();
+    }
+    return;
+  }
+
+  for (int c = 0; c < numChannels; ++c) {
+    auto gain = makeRamp(c);
+    int i = 0;
+    for (; i < vectorEnd; i += width) {
+      V const x = loadAs<V>(input[c] + i);
+      if (dry) {
+        x.store(dry[c] + i);
+      }
+      (x * gain.next()).store(io[c] + i);
+    }
+    for (; i < n; ++i) {
+      Float const x = input[c][i];
+      if (dry) {
+        dry[c][i] = x;
+      }
+      io[c][i] = x * gain.nextScalar();
+    }
+    if (isGainApplied) {
+      gainState[c] = gain.getState();
+    }
+  }
+}
+
+// writes a frame of the chain to the planar host buffer, mid side decoding
+// the first two lanes if isMidSide
+
+template<class HostFloat, class Vec>
+inline void
+storeFrame(Vec const frame,
+           HostFloat* const* output,
+           int const i,
+           int const numChannels,
+           bool const isMidSide)
+{
+  using Float = std::remove_cvref_t<decltype(std::declval<Vec const&>()[0])>;
+  alignas(sizeof(Vec)) Float lanes[Vec::size()];
+  frame.store_a(lanes);
+  if (isMidSide) {
+    output[0][i] = static_cast<HostFloat>(lanes[0] + lanes[1]);
+    output[1][i] = static_cast<HostFloat>(lanes[0] - lanes[1]);
+  }
+  else {
+    for (int c = 0; c < numChannels; ++c) {
+      output[c][i] = static_cast<HostFloat>(lanes[c]);
+    }
+  }
+}
+
+// One pass from the interleaved frames of the chain to the planar host
+// buffer. Per block, the caller sets which of the steps run; the smoothed
+// states are read from and written back to the arrays of the Dsp.
+
+template<class Vec>
+struct OutputStage
+{
+  using Float = std::remove_cvref_t<decltype(std::declval<Vec const&>()[0])>;
+
+  // the wet signal, null when bypassing: the output is then the dry signal
+  Vec const* wet = nullptr;
+  // the dry signal aligned with the wet one
+  Vec const* dry = nullptr;
+
+  // dry-wet, only when isMixing, and output gain
+  bool isMixing = false;
+  Float* wetAmount = nullptr;
+  Float const* wetAmountTarget = nullptr;
+  Float* outputGain = nullptr;
+  Float const* outputGainTarget = nullptr;
+  Float alpha = 0;
+
+  // Cross-fade toward delayedDry, by fade, which moves by fadeStep toward
+  // fadeTarget once warmUp samples have passed. Only if delayedDry is set.
+  Vec const* delayedDry = nullptr;
+  double fade = 0.0;
+  double fadeTarget = 0.0;
+  double fadeStep = 0.0;
+  int warmUp = 0;
+
+  bool isMidSide = false;
+  int numChannels = 2;
+
+  template<class HostFloat>
+  void process(HostFloat* const* output, int const numSamples)
+  {
+    Vec const alphaVec = alpha;
+    Vec amount = isMixing ? Vec().load(wetAmount) : Vec(Float(1));
+    Vec const amountTarget =
+      isMixing ? Vec().load(wetAmountTarget) : Vec(Float(1));
+    Vec gain = wet ? Vec().load(outputGain) : Vec(Float(1));
+    Vec const gainTarget = wet ? Vec().load(outputGainTarget) : Vec(Float(1));
+
+    bool const isFading = delayedDry && (fade != fadeTarget || warmUp > 0);
+
+    for (int i = 0; i < numSamples; ++i) {
+      Vec out;
+      if (wet) {
+        gain = gainTarget + alphaVec * (gain - gainTarget);
+        out = gain * wet[i];
+        if (isMixing) {
+          amount = amountTarget + alphaVec * (amount - amountTarget);
+          out = amount * (out - dry[i]) + dry[i];
+        }
+      }
+      else {
+        out = dry[i];
+      }
+
+      if (isFading) {
+        if (warmUp > 0) {
+          --warmUp;
+        }
+        else if (fade < fadeTarget) {
+          fade = std::min(fadeTarget, fade + fadeStep);
+        }
+        else {
+          fade = std::max(fadeTarget, fade - fadeStep);
+        }
+        out += Float(fade) * (delayedDry[i] - out);
+      }
+
+      storeFrame(out, output, i, numChannels, isMidSide);
+    }
+
+    if (wet) {
+      gain.store(outputGain);
+    }
+    if (isMixing) {
+      amount.store(wetAmount);
+    }
+  }
+};
+
+} // namespace curvessor
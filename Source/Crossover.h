@@ -0,0 +1,189 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Curvessor.
+
+Curvessor is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Curvessor is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Curvessor.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// Linkwitz-Riley crossover splitting interleaved SIMD frames into up to
+// maxNumBands bands, for the multiband mode. The benchmark splits its bands
+// with it too, which is why it only depends on the SIMD types.
+//
+// Each split is a fourth order Linkwitz-Riley pair, made of Butterworth state
+// variable filters (topology preserving transform): one section gives the
+// second order low-pass and high-pass of the input, and one more section on
+// each of them squares them. The bands below a split are passed through the
+// second order all-pass of that split, which is the sum of its two outputs,
+// so that the bands add up to an all-pass of the input.
+//
+// The splits cut the band above the previous one, so with three bands the
+// high-pass of the first split feeds the second split.
+
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+#include <utility>
+
+namespace curvessor {
+
+inline constexpr int maxNumBands = 3;
+
+template<class Vec>
+class Crossover final
+{
+public:
+  using Float = std::remove_cvref_t<decltype(std::declval<Vec const&>()[0])>;
+
+  // Sets the frequency of each of the numBands - 1 splits, lowest first. A
+  // split is kept above the one below it and below 0.45 times the sample
+  // rate. The coefficients are only recomputed when these change.
+  void setup(double const* frequencies, int const numBands_, double sampleRate)
+  {
+    numBands = std::clamp(numBands_, 1, maxNumBands);
+    for (int j = 0; j < numBands - 1; ++j) {
+      double frequency = std::min(frequencies[j], 0.45 * sampleRate);
+      if (j > 0) {
+        frequency = std::max(frequency, splits[j - 1].frequency);
+      }
+      auto& split = splits[j];
+      if (frequency == split.frequency && sampleRate == split.sampleRate) {
+        continue;
+      }
+      split.frequency = frequency;
+      split.sampleRate = sampleRate;
+      constexpr double pi = 3.141592653589793238463;
+      double const g = std::tan(pi * frequency / sampleRate);
+      split.g = Float(g);
+      split.h = Float(1.0 / (1.0 + g * (g + k)));
+    }
+  }
+
+  int getNumBands() const { return numBands; }
+
+  void reset()
+  {
+    for (auto& split : splits) {
+      split.input = split.low = split.high = Section{};
+      for (auto& section : split.allPass) {
+        section = Section{};
+      }
+    }
+  }
+
+  // Splits numSamples frames of io: the lowest band is left in io, band b in
+  // (*upperBands[b - 1]). Buffer is anything indexed by sample giving frames
+  // of Vec, as the VecBuffer of the interleaved oversampling buffers.
+  template<class Buffer>
+  void split(Buffer& io, Buffer* const* upperBands, int const numSamples)
+  {
+    for (int i = 0; i < numSamples; ++i) {
+      Vec bands[maxNumBands];
+      Vec rest = io[i];
+      for (int j = 0; j < numBands - 1; ++j) {
+        auto& split = splits[j];
+        auto const g = Vec(split.g);
+        auto const h = Vec(split.h);
+        for (int b = 0; b < j; ++b) {
+          bands[b] = split.allPass[b].allPass(bands[b], g, h);
+        }
+        Vec low, band, high;
+        split.input.process(rest, g, h, low, band, high);
+        bands[j] = split.low.lowPass(low, g, h);
+        rest = split.high.highPass(high, g, h);
+      }
+      io[i] = numBands > 1 ? bands[0] : rest;
+      for (int b = 1; b < numBands; ++b) {
+        (*upperBands[b - 1])[i] = b == numBands - 1 ? rest : bands[b];
+      }
+    }
+  }
+
+  // adds the upper bands back into io
+  template<class Buffer>
+  void sum(Buffer& io, Buffer* const* upperBands, int const numSamples) const
+  {
+    for (int i = 0; i < numSamples; ++i) {
+      Vec out = io[i];
+      for (int b = 1; b < numBands; ++b) {
+        out += (*upperBands[b - 1])[i];
+      }
+      io[i] = out;
+    }
+  }
+
+private:
+  // damping of the Butterworth sections
+  static constexpr double k = 1.41421356237309504880;
+
+  // g = tan(pi * frequency / sampleRate), h = 1 / (1 + g * (g + k))
+  struct Section
+  {
+    Vec s1 = Vec(Float(0));
+    Vec s2 = Vec(Float(0));
+
+    void process(Vec x, Vec g, Vec h, Vec& low, Vec& band, Vec& high)
+    {
+      high = (x - (g + Float(k)) * s1 - s2) * h;
+      auto const v1 = g * high;
+      band = v1 + s1;
+      s1 = band + v1;
+      auto const v2 = g * band;
+      low = v2 + s2;
+      s2 = low + v2;
+    }
+
+    Vec lowPass(Vec x, Vec g, Vec h)
+    {
+      Vec low, band, high;
+      process(x, g, h, low, band, high);
+      return low;
+    }
+
+    Vec highPass(Vec x, Vec g, Vec h)
+    {
+      Vec low, band, high;
+      process(x, g, h, low, band, high);
+      return high;
+    }
+
+    // the sum of the fourth order low-pass and high-pass
+    Vec allPass(Vec x, Vec g, Vec h)
+    {
+      Vec low, band, high;
+      process(x, g, h, low, band, high);
+      return x - Float(2.0 * k) * band;
+    }
+  };
+
+  struct Split
+  {
+    double frequency = -1.0;
+    double sampleRate = 0.0;
+    Float g = Float(0);
+    Float h = Float(1);
+    Section input;
+    Section low;
+    Section high;
+    // one for each of the bands below this split
+    Section allPass[maxNumBands];
+  };
+
+  Split splits[maxNumBands - 1];
+  int numBands = 1;
+};
+
+} // namespace curvessor
@@ -24,30 +24,108 @@ along with Curvessor.  If not, see <https://www.gnu.org/licenses/>.
 // EmitBuiltinExpr crash).
 
 #include "CurvessorDsp.h"
+#include "GainMath.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <array>
+#include <utility>
 
 namespace curvessor {
 
 namespace {
 
+// swaps the two channels of each stereo pair
+
 inline Vec2d
-applyStereoLink(Vec2d in,
-                Vec2d& stereo_link,
-                Vec2d& stereo_link_target,
-                Vec2d alpha)
+swapChannels(Vec2d x)
+{
+  return permute2<1, 0>(x);
+}
+
+inline Vec8d
+swapChannels(Vec8d x)
+{
+  return permute8<1, 0, 3, 2, 5, 4, 7, 6>(x);
+}
+
+inline Vec4f
+swapChannels(Vec4f x)
+{
+  return permute4<1, 0, 3, 2>(x);
+}
+
+inline Vec8f
+swapChannels(Vec8f x)
+{
+  return permute8<1, 0, 3, 2, 5, 4, 7, 6>(x);
+}
+
+// A smoothed setting at control rate: begin moves the one pole smoother to
+// where it is at the end of the control block, and next interpolates toward
+// it linearly, reaching it at the last sample of the block.
+
+template<class Vec>
+struct ControlRamp
 {
-  auto const mean = 0.5 * (in + permute2<1, 0>(in));
-  stereo_link = stereo_link_target + alpha * (stereo_link - stereo_link_target);
+  Vec value;
+  Vec step;
+
+  void begin(Vec& state, Vec target, Vec alpha_power, Vec inv_length)
+  {
+    Vec const end = target + alpha_power * (state - target);
+    value = state;
+    step = (end - state) * inv_length;
+    state = end;
+  }
+
+  Vec next()
+  {
+    value += step;
+    return value;
+  }
+};
+
+template<class Vec>
+inline Vec
+applyStereoLink(Vec in, Vec stereo_link)
+{
+  auto const mean = Vec(0.5f) * (in + swapChannels(in));
   return in + stereo_link * (mean - in);
 }
 
-inline Vec2d
-toVumeter(Vec2d vumeter_state, Vec2d env, Vec2d alpha)
+// Moves each linked lane toward the link matrix applied to the linked lanes.
+// The product broadcasts one lane at a time, which is fine for up to 8 lanes.
+// Lanes outside the group, idle ones included, are never read.
+
+template<class Vec>
+inline Vec
+applyBusLink(Vec in, Vec bus_link, TDsp<Vec> const& dsp)
+{
+  constexpr int numLanes = Vec::size();
+  using Float = typename TDsp<Vec>::Float;
+
+  Vec linked = Vec(Float(0));
+  for (int k = 0; k < dsp.numLinkedLanes; ++k) {
+    int const j = dsp.linkedLanes[k];
+    linked =
+      mul_add(Vec().load(dsp.linkMatrix + j * numLanes), Vec(in[j]), linked);
+  }
+  linked = select(Vec().load(dsp.linkedLaneMask) != Vec(Float(0)), linked, in);
+
+  return in + bus_link * (linked - in);
+}
+
+template<class Vec>
+inline Vec
+toVumeter(Vec vumeter_state, Vec env, Vec alpha)
 {
   return env + alpha * (vumeter_state - env);
 }
 
-inline Vec2d
-applyHighPassFilter(Vec2d input, Vec2d& state, Vec2d g)
+template<class Vec>
+inline Vec
+applyHighPassFilter(Vec input, Vec& state, Vec g)
 {
   auto const v = g * (input - state);
   auto const low = v + state;
@@ -55,224 +133,617 @@ applyHighPassFilter(Vec2d input, Vec2d& state, Vec2d g)
   return input - low;
 }
 
-constexpr double ln10 = 2.30258509299404568402;
-constexpr double db_to_lin = ln10 / 20.0;
+inline Vec2q
+toTableIndex(Vec2d x)
+{
+  return truncate_to_int64(x);
+}
 
-} // namespace
+inline Vec8q
+toTableIndex(Vec8d x)
+{
+  return truncate_to_int64(x);
+}
+
+inline Vec4i
+toTableIndex(Vec4f x)
+{
+  return truncatei(x);
+}
+
+inline Vec8i
+toTableIndex(Vec8f x)
+{
+  return truncatei(x);
+}
+
+// Linear interpolation of the gain table. Outside of the table range the end
+// cells are extrapolated, which matches the spline: all the knots lie inside
+// the range, and beyond the outer knots the spline is a straight line.
+
+template<class Vec, class Float>
+inline Vec
+lookupGainTable(Float const* table, Vec x)
+{
+  constexpr int numLanes = Vec::size();
+  constexpr int size = TDsp<Vec>::gainTableSize;
+  constexpr double minDb = TDsp<Vec>::gainTableMinDb;
+  constexpr double maxDb = TDsp<Vec>::gainTableMaxDb;
+  constexpr double pointsPerDb = (size - 1) / (maxDb - minDb);
+  constexpr Float laneOffsets[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+
+  Vec const position = (x - Float(minDb)) * Float(pointsPerDb);
+  Vec const cell =
+    min(max(floor(position), Vec(Float(0))), Vec(Float(size - 2)));
+  Vec const fraction = position - cell;
+
+  auto const index =
+    toTableIndex(cell * Float(numLanes) + Vec().load(laneOffsets));
 
+  Vec const left = lookup<size * numLanes>(index, table);
+  Vec const right = lookup<size * numLanes>(index + numLanes, table);
+
+  return left + fraction * (right - left);
+}
+
+enum class Topology
+{
+  forward,
+  feedback,
+  sidechain
+};
+
+// The features a kernel is specialized on besides the topology, the high-pass
+// order and the knot count, as a bit mask. They are off most of the time.
+
+inline constexpr int lookaheadFeature = 1;
+inline constexpr int gainBandLimitFeature = 2;
+inline constexpr int busLinkFeature = 4;
+inline constexpr int numFeatureSets = 8;
+
+template<class Vec>
+int
+getFeatures(TDsp<Vec> const& dsp)
+{
+  using Float = typename TDsp<Vec>::Float;
+  int features = 0;
+  if (dsp.lookaheadRing && dsp.lookaheadDelay > 0) {
+    features |= lookaheadFeature;
+  }
+  if (dsp.gainLowPassCoef != Float(0)) {
+    features |= gainBandLimitFeature;
+  }
+  if (dsp.isBusLinked) {
+    features |= busLinkFeature;
+  }
+  return features;
+}
+
+// numActiveKnots == 0 selects the gain table instead of the spline
+
+template<class Vec,
+         Topology topology,
+         int features,
+         int highPassOrder,
+         int numActiveKnots>
 void
-Dsp::forwardProcess(VecBuffer<Vec2d>& io,
-                    int const numActiveKnots,
-                    int const highPassOrder)
+processKernel(TDsp<Vec>& dsp, VecBuffer<Vec>& io, VecBuffer<Vec>& sidechain)
 {
-  auto spline = autoSpline.spline.getVecSpline();
-  auto automation = autoSpline.automator.getVecAutomator();
-  auto envelope = envelopeFollower.getVecData();
+  constexpr bool isFeedback = topology == Topology::feedback;
+  constexpr bool isSidechain = topology == Topology::sidechain;
+  constexpr bool isUsingGainTable = numActiveKnots == 0;
+  constexpr bool isLookingAhead = (features & lookaheadFeature) != 0;
+  constexpr bool isGainBandLimited = (features & gainBandLimitFeature) != 0;
+  constexpr bool isBusLinked = (features & busLinkFeature) != 0;
+  using Float = typename TDsp<Vec>::Float;
 
-  auto stereo_link_target = Vec2d(stereoLinkTarget);
-  auto automation_alpha = Vec2d(automationAlpha);
+  auto spline = dsp.autoSpline.spline.getVecSpline();
+  auto automation = dsp.autoSpline.automator.getVecAutomator();
+  auto envelope = dsp.envelopeFollower.getVecData();
 
-  auto stereo_link = Vec2d().load(stereoLink);
-  auto gain_vumeter = Vec2d().load(gainVuMeterBuffer);
-  auto level_vumeter = Vec2d().load(levelVuMeterBuffer);
+  auto stereo_link_target = Vec().load(dsp.stereoLinkTarget);
+  auto automation_alpha = Vec(dsp.automationAlpha);
 
-  auto high_pass_state = Vec2d().load(highPassState);
-  auto high_pass_coef = Vec2d().load(highPassCoef);
-  auto high_pass_state_2 = Vec2d().load(highPassState2);
-  auto high_pass_state_3 = Vec2d().load(highPassState3);
+  auto stereo_link = Vec().load(dsp.stereoLink);
 
-  int const numSamples = io.getNumSamples();
+  auto const bus_link_target = Vec(dsp.busLinkTarget);
+  auto bus_link = Vec().load(dsp.busLink);
+  auto gain_vumeter = Vec().load(dsp.gainVuMeterBuffer);
+  auto level_vumeter = Vec().load(dsp.levelVuMeterBuffer);
 
-  for (int i = 0; i < numSamples; ++i) {
+  auto feedback_amount_target = Vec().load(dsp.feedbackAmountTarget);
+  auto feedback_amount = Vec().load(dsp.feedbackAmount);
+  auto feedback = Vec().load(dsp.feedbackBuffer);
+
+  auto high_pass_coef = Vec().load(dsp.highPassCoef);
+  auto high_pass_state = Vec().load(dsp.highPassState);
+  auto high_pass_state_2 = Vec().load(dsp.highPassState2);
+  auto high_pass_state_3 = Vec().load(dsp.highPassState3);
+
+  Vec* const gain_output = dsp.gainOutput;
+  int const gain_output_shift = dsp.gainOutputLog2Stride;
+
+  Vec* const lookahead_ring = dsp.lookaheadRing;
+  int const lookahead_mask = dsp.lookaheadMask;
+  int const lookahead_delay = dsp.lookaheadDelay;
+  int lookahead_write = dsp.lookaheadWriteIndex;
+
+  int const numSamples = io.getNumSamples();
+  int const controlBlockSize = TDsp<Vec>::controlBlockSize;
+
+  // the detector runs once every decimation samples, see detectorDecimation
+  int const decimation = std::max(dsp.detectorDecimation, 1);
+  int const numSteps = numSamples / decimation;
+  auto const inv_decimation = Vec(Float(1) / Float(decimation));
+  auto split_rate_gain = Vec().load(dsp.splitRateGain);
+
+  auto const gain_low_pass_coef = Vec(dsp.gainLowPassCoef);
+  auto gain_low_pass_state = Vec().load(dsp.gainLowPassState);
+  auto gain_low_pass_state_2 = Vec().load(dsp.gainLowPassState2);
+
+  ControlRamp<Vec> stereo_link_ramp;
+  ControlRamp<Vec> bus_link_ramp;
+  ControlRamp<Vec> feedback_amount_ramp;
+
+  // the gain of each detector step of a control block, in dB, copied to
+  // gainOutput once the block is done
+  Vec control_gain[controlBlockSize];
+
+  // see TDsp::gainLowPassCoef
+  auto const bandLimitGain = [&](Vec gain) {
+    if constexpr (isGainBandLimited) {
+      gain_low_pass_state += gain_low_pass_coef * (gain - gain_low_pass_state);
+      gain_low_pass_state_2 +=
+        gain_low_pass_coef * (gain_low_pass_state - gain_low_pass_state_2);
+      return gain_low_pass_state_2;
+    }
+    else {
+      return gain;
+    }
+  };
+
+  // the audio the gain is applied to, behind the detector by the lookahead
+  auto const delayAudio = [&](Vec in) {
+    if constexpr (isLookingAhead) {
+      lookahead_ring[lookahead_write] = in;
+      Vec const audio =
+        lookahead_ring[(lookahead_write - lookahead_delay) & lookahead_mask];
+      lookahead_write = (lookahead_write + 1) & lookahead_mask;
+      return audio;
+    }
+    else {
+      return in;
+    }
+  };
 
-    Vec2d in = io[i];
+  // from the detector input, main or sidechain, to the gain in dB
+  auto const computeGain = [&](Vec in) {
+    Vec env_in = in;
 
-    Vec2d env_in = in;
+    if constexpr (isFeedback) {
+      env_in = in + feedback_amount_ramp.next() * (feedback - in);
+    }
 
-    if (highPassOrder >= 1) {
-      env_in = applyHighPassFilter(in, high_pass_state, high_pass_coef);
+    if constexpr (highPassOrder >= 1) {
+      env_in = applyHighPassFilter(env_in, high_pass_state, high_pass_coef);
     }
 
-    if (highPassOrder >= 2) {
+    if constexpr (highPassOrder >= 2) {
       env_in = applyHighPassFilter(env_in, high_pass_state_2, high_pass_coef);
     }
 
-    if (highPassOrder >= 3) {
+    if constexpr (highPassOrder >= 3) {
       env_in = applyHighPassFilter(env_in, high_pass_state_3, high_pass_coef);
     }
 
-    Vec2d env_out = envelope.processDB(env_in);
+    Vec env_out = envelope.processDB(env_in);
 
-    env_out = applyStereoLink(
-      env_out, stereo_link, stereo_link_target, automation_alpha);
+    env_out = applyStereoLink(env_out, stereo_link_ramp.next());
+
+    if constexpr (isBusLinked) {
+      env_out = applyBusLink(env_out, bus_link_ramp.next(), dsp);
+    }
 
     level_vumeter = toVumeter(level_vumeter, env_out, automation_alpha);
 
-    Vec2d gc = spline.process(env_out, automation, numActiveKnots);
+    Vec gc;
 
-    gc -= env_out;
+    if constexpr (isUsingGainTable) {
+      gc = lookupGainTable(dsp.gainTable, env_out);
+    }
+    else {
+      gc = spline.process(env_out, automation, numActiveKnots);
+      gc -= env_out;
+    }
 
     gain_vumeter = toVumeter(gain_vumeter, gc, automation_alpha);
 
-    gc = exp(db_to_lin * gc);
+    return gc;
+  };
 
-    io[i] = in * gc;
-  }
+  for (int block = 0; block < numSteps; block += controlBlockSize) {
 
-  autoSpline.spline.update(spline, numActiveKnots);
-  envelope.update(envelopeFollower);
-  stereo_link.store(stereoLink);
-  gain_vumeter.store(gainVuMeterBuffer);
-  level_vumeter.store(levelVuMeterBuffer);
-  high_pass_state.store(highPassState);
-  high_pass_state_2.store(highPassState2);
-  high_pass_state_3.store(highPassState3);
-}
+    int const blockEnd = std::min(block + controlBlockSize, numSteps);
+    int const blockLength = blockEnd - block;
 
-void
-Dsp::feedbackProcess(VecBuffer<Vec2d>& io,
-                     int const numActiveKnots,
-                     int const highPassOrder)
-{
-  auto spline = autoSpline.spline.getVecSpline();
-  auto automation = autoSpline.automator.getVecAutomator();
+    // only the last control block of a call may be shorter
+    auto const alpha_power =
+      blockLength == controlBlockSize
+        ? Vec(dsp.controlAlpha)
+        : Vec(std::pow(dsp.automationAlpha, Float(blockLength)));
+    auto const inv_length = Vec(Float(1) / Float(blockLength));
+
+    stereo_link_ramp.begin(
+      stereo_link, stereo_link_target, alpha_power, inv_length);
+    if constexpr (isBusLinked) {
+      bus_link_ramp.begin(bus_link, bus_link_target, alpha_power, inv_length);
+    }
+    if constexpr (isFeedback) {
+      feedback_amount_ramp.begin(
+        feedback_amount, feedback_amount_target, alpha_power, inv_length);
+    }
 
-  auto envelope = envelopeFollower.getVecData();
+    if (decimation == 1) {
+      for (int i = block; i < blockEnd; ++i) {
+        Vec const in = io[i];
+        Vec const audio = delayAudio(in);
 
-  auto stereo_link_target = Vec2d(stereoLinkTarget);
-  auto automation_alpha = Vec2d(automationAlpha);
+        Vec gc = computeGain(isSidechain ? sidechain[i] : in);
+        control_gain[i - block] = gc;
 
-  auto stereo_link = Vec2d().load(stereoLink);
-  auto gain_vumeter = Vec2d().load(gainVuMeterBuffer);
-  auto level_vumeter = Vec2d().load(levelVuMeterBuffer);
+        gc = dbToLinear<gainAccuracy>(gc);
+        split_rate_gain = gc;
 
-  auto feedback_amount_target = Vec2d().load(feedbackAmountTarget);
-  auto feedback_amount = Vec2d().load(feedbackAmount);
-  auto env_in = Vec2d().load(feedbackBuffer);
+        Vec const out = audio * bandLimitGain(gc);
 
-  auto high_pass_state = Vec2d().load(highPassState);
-  auto high_pass_coef = Vec2d().load(highPassCoef);
-  auto high_pass_state_2 = Vec2d().load(highPassState2);
-  auto high_pass_state_3 = Vec2d().load(highPassState3);
+        if constexpr (isFeedback) {
+          feedback = out;
+        }
 
-  int const numSamples = io.getNumSamples();
+        io[i] = out;
+      }
 
-  for (int s = 0; s < numSamples; ++s) {
+      if (gain_output) {
+        for (int i = block; i < blockEnd; ++i) {
+          gain_output[i >> gain_output_shift] = control_gain[i - block];
+        }
+      }
+      continue;
+    }
 
-    Vec2d in = io[s];
+    // Split rate: the detector reads the peak of each group of decimation
+    // samples, and its gain is interpolated linearly over the next group,
+    // which also low-passes it before it modulates the audio.
 
-    feedback_amount =
-      feedback_amount +
-      automation_alpha * (feedback_amount_target - feedback_amount);
+    for (int step = block; step < blockEnd; ++step) {
+      int const first = step * decimation;
+      VecBuffer<Vec>& detected = isSidechain ? sidechain : io;
 
-    env_in = in + feedback_amount * (env_in - in);
+      Vec peak = detected[first];
+      for (int k = 1; k < decimation; ++k) {
+        Vec const x = detected[first + k];
+        peak = select(abs(x) > abs(peak), x, peak);
+      }
 
-    if (highPassOrder >= 1) {
-      env_in = applyHighPassFilter(env_in, high_pass_state, high_pass_coef);
+      Vec const gc = computeGain(peak);
+      control_gain[step - block] = gc;
+
+      Vec const gain_step =
+        (dbToLinear<gainAccuracy>(gc) - split_rate_gain) * inv_decimation;
+
+      Vec out;
+      for (int i = first; i < first + decimation; ++i) {
+        split_rate_gain += gain_step;
+        out = delayAudio(io[i]) * bandLimitGain(split_rate_gain);
+        io[i] = out;
+      }
+
+      if constexpr (isFeedback) {
+        feedback = out;
+      }
     }
 
-    if (highPassOrder >= 2) {
-      env_in = applyHighPassFilter(env_in, high_pass_state_2, high_pass_coef);
+    if (gain_output) {
+      for (int step = block; step < blockEnd; ++step) {
+        int const first = step * decimation;
+        for (int i = first; i < first + decimation; ++i) {
+          gain_output[i >> gain_output_shift] = control_gain[step - block];
+        }
+      }
     }
+  }
 
-    Vec2d env_out = envelope.processDB(env_in);
+  split_rate_gain.store(dsp.splitRateGain);
+  gain_low_pass_state.store(dsp.gainLowPassState);
+  gain_low_pass_state_2.store(dsp.gainLowPassState2);
 
-    env_out = applyStereoLink(
-      env_out, stereo_link, stereo_link_target, automation_alpha);
+  if constexpr (!isUsingGainTable) {
+    dsp.autoSpline.spline.update(spline, numActiveKnots);
+  }
+  envelope.update(dsp.envelopeFollower);
+  dsp.lookaheadWriteIndex = lookahead_write;
+  stereo_link.store(dsp.stereoLink);
+  bus_link.store(dsp.busLink);
+  gain_vumeter.store(dsp.gainVuMeterBuffer);
+  level_vumeter.store(dsp.levelVuMeterBuffer);
+
+  if constexpr (isFeedback) {
+    feedback.store(dsp.feedbackBuffer);
+    feedback_amount.store(dsp.feedbackAmount);
+  }
 
-    level_vumeter = toVumeter(level_vumeter, env_out, automation_alpha);
+  if constexpr (highPassOrder >= 1) {
+    high_pass_state.store(dsp.highPassState);
+  }
+  if constexpr (highPassOrder >= 2) {
+    high_pass_state_2.store(dsp.highPassState2);
+  }
+  if constexpr (highPassOrder >= 3) {
+    high_pass_state_3.store(dsp.highPassState3);
+  }
+}
 
-    Vec2d gc = spline.process(env_out, automation, numActiveKnots);
+// A band with no active knot is left at unity gain, but it still goes through
+// the lookahead, so that it stays aligned with the other bands and with the
+// dry signal. The gain states are set to unity, where the kernels pick up.
 
-    gc -= env_out;
+template<class Vec>
+void
+passThrough(TDsp<Vec>& dsp, VecBuffer<Vec>& io)
+{
+  using Float = typename TDsp<Vec>::Float;
+  constexpr int numLanes = Vec::size();
 
-    gain_vumeter = toVumeter(gain_vumeter, gc, automation_alpha);
+  int const numSamples = io.getNumSamples();
 
-    gc = exp(db_to_lin * gc);
+  if (dsp.gainOutput) {
+    for (int i = 0; i < numSamples; ++i) {
+      dsp.gainOutput[i >> dsp.gainOutputLog2Stride] = Vec(Float(0));
+    }
+  }
+
+  std::fill_n(dsp.splitRateGain, numLanes, Float(1));
+  std::fill_n(dsp.gainLowPassState, numLanes, Float(1));
+  std::fill_n(dsp.gainLowPassState2, numLanes, Float(1));
 
-    io[s] = env_in = in * gc;
+  Vec* const lookahead_ring = dsp.lookaheadRing;
+  if (!lookahead_ring || dsp.lookaheadDelay <= 0) {
+    return;
   }
 
-  autoSpline.spline.update(spline, numActiveKnots);
-  envelope.update(envelopeFollower);
+  int const lookahead_mask = dsp.lookaheadMask;
+  int const lookahead_delay = dsp.lookaheadDelay;
+  int lookahead_write = dsp.lookaheadWriteIndex;
+
+  for (int i = 0; i < numSamples; ++i) {
+    lookahead_ring[lookahead_write] = io[i];
+    io[i] =
+      lookahead_ring[(lookahead_write - lookahead_delay) & lookahead_mask];
+    lookahead_write = (lookahead_write + 1) & lookahead_mask;
+  }
 
-  stereo_link.store(stereoLink);
-  gain_vumeter.store(gainVuMeterBuffer);
-  level_vumeter.store(levelVuMeterBuffer);
-  env_in.store(feedbackBuffer);
-  feedback_amount.store(feedbackAmount);
-  high_pass_state.store(highPassState);
-  high_pass_state_2.store(highPassState2);
+  dsp.lookaheadWriteIndex = lookahead_write;
 }
 
+// One kernel per (feature set, high-pass order, number of active knots), so
+// that the filter cascade and the optional stages are resolved at compile
+// time and the spline evaluation sees a constant knot count it can unroll.
+// The entry is picked once per block. The entry for 0 knots reads the gain
+// table.
+
+template<class Vec>
+using Kernel = void (*)(TDsp<Vec>&, VecBuffer<Vec>&, VecBuffer<Vec>&);
+
+inline constexpr int maxHighPassOrder = 3;
+
+template<class Vec>
+using KernelRow = std::array<Kernel<Vec>, maxNumKnots + 1>;
+
+template<class Vec>
+using KernelTable =
+  std::array<std::array<KernelRow<Vec>, maxHighPassOrder + 1>, numFeatureSets>;
+
+template<class Vec,
+         Topology topology,
+         int features,
+         int highPassOrder,
+         int... numKnots>
+constexpr KernelRow<Vec>
+makeKernelRow(std::integer_sequence<int, numKnots...>)
+{
+  return {
+    &processKernel<Vec, topology, features, highPassOrder, numKnots>...
+  };
+}
+
+template<class Vec, Topology topology, int features, int... highPassOrders>
+constexpr std::array<KernelRow<Vec>, maxHighPassOrder + 1>
+makeKernelRows(std::integer_sequence<int, highPassOrders...>)
+{
+  return { makeKernelRow<Vec, topology, features, highPassOrders>(
+    std::make_integer_sequence<int, maxNumKnots + 1>{})... };
+}
+
+template<class Vec, Topology topology, int... features>
+constexpr KernelTable<Vec>
+makeKernelTable(std::integer_sequence<int, features...>)
+{
+  return { makeKernelRows<Vec, topology, features>(
+    std::make_integer_sequence<int, maxHighPassOrder + 1>{})... };
+}
+
+template<class Vec, Topology topology>
+inline constexpr auto kernelTable = makeKernelTable<Vec, topology>(
+  std::make_integer_sequence<int, numFeatureSets>{});
+
+template<Topology topology, class Vec>
 void
-Dsp::sidechainProcess(VecBuffer<Vec2d>& io,
-                      VecBuffer<Vec2d>& sidechain,
-                      int const numActiveKnots,
-                      int const highPassOrder)
+dispatch(TDsp<Vec>& dsp,
+         VecBuffer<Vec>& io,
+         VecBuffer<Vec>& sidechain,
+         int const numActiveKnots,
+         int const highPassOrder)
 {
-  auto spline = autoSpline.spline.getVecSpline();
-  auto automation = autoSpline.automator.getVecAutomator();
+  if (numActiveKnots < 1) {
+    passThrough(dsp, io);
+    return;
+  }
+  bool const isGainTableReady = dsp.isGainTableReady();
+  auto const numKnots =
+    isGainTableReady ? 0 : std::min(numActiveKnots, maxNumKnots);
+  auto const orderIndex = std::clamp(highPassOrder, 0, maxHighPassOrder);
+  kernelTable<Vec, topology>[getFeatures(dsp)][orderIndex][numKnots](
+    dsp, io, sidechain);
+
+  // the knots only move toward their targets in the spline kernels
+  if (!isGainTableReady) {
+    dsp.gainTableSettlingSamples +=
+      io.getNumSamples() / std::max(dsp.detectorDecimation, 1);
+  }
+}
 
-  auto envelope = envelopeFollower.getVecData();
+} // namespace
 
-  auto automation_alpha = Vec2d(automationAlpha);
-  auto stereo_link_target = Vec2d(stereoLinkTarget);
+template<class Vec>
+void
+TDsp<Vec>::updateGainTable(int const numActiveKnots)
+{
+  bool const haveTargetsChanged =
+    numActiveKnots != gainTableNumKnots ||
+    std::memcmp(&gainTableTargets,
+                &autoSpline.automator,
+                sizeof(gainTableTargets)) != 0;
+
+  if (haveTargetsChanged) {
+    gainTableTargets = autoSpline.automator;
+    gainTableNumKnots = numActiveKnots;
+    gainTableNumPoints = 0;
+    gainTableSettlingSamples = 0.0;
+  }
 
-  auto stereo_link = Vec2d().load(stereoLink);
-  auto gain_vumeter = Vec2d().load(gainVuMeterBuffer);
-  auto level_vumeter = Vec2d().load(levelVuMeterBuffer);
+  if (numActiveKnots < 1 || isGainTableReady()) {
+    return;
+  }
 
-  auto high_pass_state = Vec2d().load(highPassState);
-  auto high_pass_coef = Vec2d().load(highPassCoef);
-  auto high_pass_state_2 = Vec2d().load(highPassState2);
-  auto high_pass_state_3 = Vec2d().load(highPassState3);
+  // the knots are within 1e-6 of their targets after this many samples
+  double const alpha = automationAlpha;
+  double const samplesToSettle =
+    alpha > 0.0 ? std::log(1e-6) / std::log(alpha) : 0.0;
 
-  int const numSamples = io.getNumSamples();
+  if (gainTableSettlingSamples < samplesToSettle) {
+    return;
+  }
 
-  for (int s = 0; s < numSamples; ++s) {
-    Vec2d in = io[s];
+  // The knots are within 1e-6 of their targets: they are set to them, so that
+  // the table is built from the targets, and the spline, which the kernels
+  // leave alone while they read the table, stays in sync with it. The spline
+  // is evaluated on copies of its state.
+  if (gainTableNumPoints == 0) {
+    autoSpline.reset();
+  }
 
-    Vec2d env_in = sidechain[s];
+  auto spline = autoSpline.spline.getVecSpline();
+  auto automation = autoSpline.automator.getVecAutomator();
 
-    if (highPassOrder >= 1) {
-      env_in = applyHighPassFilter(env_in, high_pass_state, high_pass_coef);
-    }
+  double const dbPerPoint =
+    (gainTableMaxDb - gainTableMinDb) / (gainTableSize - 1);
 
-    if (highPassOrder >= 2) {
-      env_in = applyHighPassFilter(env_in, high_pass_state_2, high_pass_coef);
-    }
+  int const end =
+    std::min(gainTableNumPoints + gainTablePointsPerBlock, gainTableSize);
 
-    if (highPassOrder >= 3) {
-      env_in = applyHighPassFilter(env_in, high_pass_state_3, high_pass_coef);
-    }
+  for (int i = gainTableNumPoints; i < end; ++i) {
+    auto const x = Vec(Float(gainTableMinDb + i * dbPerPoint));
+    auto const gc = spline.process(x, automation, numActiveKnots) - x;
+    gc.store(gainTable + i * numLanes);
+  }
 
-    Vec2d env_out = envelope.processDB(env_in);
+  gainTableNumPoints = end;
+}
 
-    env_out = applyStereoLink(
-      env_out, stereo_link, stereo_link_target, automation_alpha);
+template<class Vec>
+void
+TDsp<Vec>::setBusLinkGroup(unsigned const laneMask)
+{
+  numLinkedLanes = 0;
+  for (int lane = 0; lane < numLanes; ++lane) {
+    bool const isLinked = (laneMask >> lane) & 1;
+    linkedLaneMask[lane] = isLinked ? Float(1) : Float(0);
+    if (isLinked) {
+      linkedLanes[numLinkedLanes++] = lane;
+    }
+  }
 
-    level_vumeter = toVumeter(level_vumeter, env_out, automation_alpha);
+  for (int j = 0; j < numLanes; ++j) {
+    for (int i = 0; i < numLanes; ++i) {
+      linkMatrix[j * numLanes + i] =
+        linkedLaneMask[i] * linkedLaneMask[j] / std::max(numLinkedLanes, 1);
+    }
+  }
 
-    Vec2d gc = spline.process(env_out, automation, numActiveKnots);
+  isBusLinked = numLinkedLanes > 1;
+}
 
-    gc -= env_out;
+template<class Vec>
+void
+TDsp<Vec>::copySharedSettings(TDsp const& other)
+{
+  std::copy_n(other.stereoLinkTarget, numLanes, stereoLinkTarget);
+  std::copy_n(other.feedbackAmountTarget, numLanes, feedbackAmountTarget);
+  std::copy_n(other.highPassCoef, numLanes, highPassCoef);
+  std::copy_n(other.linkMatrix, numLanes * numLanes, linkMatrix);
+  std::copy_n(other.linkedLaneMask, numLanes, linkedLaneMask);
+  std::copy_n(other.linkedLanes, numLanes, linkedLanes);
+  numLinkedLanes = other.numLinkedLanes;
+  isBusLinked = other.isBusLinked;
+  busLinkTarget = other.busLinkTarget;
+  automationAlpha = other.automationAlpha;
+  controlAlpha = other.controlAlpha;
+  detectorDecimation = other.detectorDecimation;
+  gainLowPassCoef = other.gainLowPassCoef;
+  lookaheadDelay = std::min(other.lookaheadDelay, lookaheadMask);
+}
 
-    gain_vumeter = toVumeter(gain_vumeter, gc, automation_alpha);
+template<class Vec>
+void
+TDsp<Vec>::resetGainTable()
+{
+  gainTableNumKnots = 0;
+  gainTableNumPoints = 0;
+  gainTableSettlingSamples = 0.0;
+}
 
-    gc = exp(db_to_lin * gc);
+template<class Vec>
+void
+TDsp<Vec>::forwardProcess(VecBuffer<Vec>& io,
+                          int const numActiveKnots,
+                          int const highPassOrder)
+{
+  dispatch<Topology::forward>(*this, io, io, numActiveKnots, highPassOrder);
+}
 
-    io[s] = in * gc;
-  }
+template<class Vec>
+void
+TDsp<Vec>::feedbackProcess(VecBuffer<Vec>& io,
+                           int const numActiveKnots,
+                           int const highPassOrder)
+{
+  dispatch<Topology::feedback>(*this, io, io, numActiveKnots, highPassOrder);
+}
 
-  autoSpline.spline.update(spline, numActiveKnots);
-  envelope.update(envelopeFollower);
-  stereo_link.store(stereoLink);
-  gain_vumeter.store(gainVuMeterBuffer);
-  level_vumeter.store(levelVuMeterBuffer);
-  high_pass_state.store(highPassState);
-  high_pass_state_2.store(highPassState2);
-  high_pass_state_3.store(highPassState3);
+template<class Vec>
+void
+TDsp<Vec>::sidechainProcess(VecBuffer<Vec>& io,
+                            VecBuffer<Vec>& sidechain,
+                            int const numActiveKnots,
+                            int const highPassOrder)
+{
+  dispatch<Topology::sidechain>(
+    *this, io, sidechain, numActiveKnots, highPassOrder);
 }
 
+template struct TDsp<Vec2d>;
+template struct TDsp<Vec8d>;
+template struct TDsp<Vec4f>;
+template struct TDsp<Vec8f>;
+
 } // namespace curvessor
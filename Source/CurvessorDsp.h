@@ -27,6 +27,9 @@ along with Curvessor.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "adsp/GammaEnv.hpp"
 #include "adsp/Spline.hpp"
+#include <cmath>
+#include <type_traits>
+#include <utility>
 
 namespace curvessor {
 
@@ -37,48 +40,190 @@ using Spline = adsp::Spline<Vec2d, maxNumKnots>;
 using AutoSpline = adsp::AutoSpline<Vec2d, maxNumKnots>;
 using SplineAutomator = Spline::SmoothingAutomator;
 
-struct Dsp
+// The Dsp state is generic over the SIMD type, so that wider registers can
+// carry more than one stereo pair: lanes 2k and 2k+1 are always the two
+// channels of the k-th pair, and the stereo link only mixes within a pair.
+// Per-lane settings are addressed with the lane index, as for Vec2d. The
+// scalar members follow the precision of Vec, so Vec4f/Vec8f give a single
+// precision Dsp.
+//
+// Detection can also be linked across all the lanes through linkMatrix, see
+// setBusLinkGroup. A multichannel bus uses it to share detection between its
+// pairs.
+
+template<class Vec>
+struct TDsp
 {
-  AutoSpline autoSpline;
-
-  adsp::GammaEnv<Vec2d> envelopeFollower;
-
-  double stereoLink[2];
-  double wetAmount[2];
-  double inputGain[2];
-  double outputGain[2];
-  double sidechainInputGain[2];
-  double feedbackBuffer[2];
-  double feedbackAmount[2];
-  double feedbackAmountTarget[2];
-  double rmsAlpha[2];
-  double levelVuMeterBuffer[2];
-  double gainVuMeterBuffer[2];
-  double highPassCoef[2];
-  double highPassState[2];
-  double highPassState2[2];
-  double highPassState3[2];
-  double automationAlpha;
-  double stereoLinkTarget;
-
-  Dsp()
+  static constexpr int numLanes = Vec::size();
+  static_assert(numLanes % 2 == 0, "lanes hold whole stereo pairs");
+
+  using Float = std::remove_cvref_t<decltype(std::declval<Vec const&>()[0])>;
+
+  adsp::AutoSpline<Vec, maxNumKnots> autoSpline;
+
+  adsp::GammaEnv<Vec> envelopeFollower;
+
+  Float stereoLink[numLanes];
+  Float wetAmount[numLanes];
+  Float inputGain[numLanes];
+  Float outputGain[numLanes];
+  Float sidechainInputGain[numLanes];
+  Float feedbackBuffer[numLanes];
+  Float feedbackAmount[numLanes];
+  Float feedbackAmountTarget[numLanes];
+  Float rmsAlpha[numLanes];
+  Float levelVuMeterBuffer[numLanes];
+  Float gainVuMeterBuffer[numLanes];
+  Float highPassCoef[numLanes];
+  Float highPassState[numLanes];
+  Float highPassState2[numLanes];
+  Float highPassState3[numLanes];
+  Float stereoLinkTarget[numLanes];
+  Float busLink[numLanes];
+  Float splitRateGain[numLanes];
+  Float gainLowPassState[numLanes];
+  Float gainLowPassState2[numLanes];
+  Float automationAlpha;
+  Float busLinkTarget;
+
+  // The kernels advance the smoothing of the stereo link, the bus link and
+  // the feedback amount once per control block of controlBlockSize samples,
+  // by controlAlpha = automationAlpha^controlBlockSize, and interpolate it
+  // linearly within the block. Set both with setAutomationAlpha.
+  static constexpr int controlBlockSize = 16;
+  Float controlAlpha;
+
+  void setAutomationAlpha(Float const alpha)
   {
-    AVEC_ASSERT_ALIGNMENT(this, Vec2d);
-    std::fill_n(stereoLink, 2 * 15, 0.0);
+    automationAlpha = alpha;
+    controlAlpha = std::pow(alpha, Float(controlBlockSize));
   }
 
-  void forwardProcess(VecBuffer<Vec2d>& io,
+  // Column j holds the weights of lane j in the linked level of every lane,
+  // only the columns in linkedLanes are read, and the lanes not in the group
+  // keep their own level. The level of each linked lane moves from its own
+  // toward the linked one by busLink. Only applied when isBusLinked.
+  Float linkMatrix[numLanes * numLanes];
+  Float linkedLaneMask[numLanes];
+  int linkedLanes[numLanes];
+  int numLinkedLanes = 0;
+  bool isBusLinked = false;
+
+  // When set, the kernels write the gain computer output, in dB, to
+  // gainOutput[i >> gainOutputLog2Stride] for the i-th processed sample, so
+  // that with the oversampling factor as stride it gets one frame per input
+  // sample. Used to send the gain on the gain link.
+  Vec* gainOutput = nullptr;
+  int gainOutputLog2Stride = 0;
+
+  // Lookahead: the gain is applied to the audio lookaheadDelay samples after
+  // the one the detector reads, through an interleaved ring owned by the host
+  // of the Dsp. The ring size is lookaheadMask + 1, a power of two, so the
+  // delay is at most lookaheadMask. A null ring or a zero delay disable it.
+  Vec* lookaheadRing = nullptr;
+  int lookaheadMask = 0;
+  int lookaheadDelay = 0;
+  int lookaheadWriteIndex = 0;
+
+  // Split rate detection: the detector and the gain computer run once every
+  // detectorDecimation samples, on the peak of those samples, and the linear
+  // gain, kept in splitRateGain, is interpolated up to the rate of the audio.
+  // The block sizes of the kernels must be multiples of it. The settings of
+  // the detector, automationAlpha included, are then for the lower rate.
+  int detectorDecimation = 1;
+
+  // Band-limited gain: with a gainLowPassCoef other than zero, the linear
+  // gain goes through two one pole low-passes, with states gainLowPassState
+  // and gainLowPassState2, before it multiplies the audio. Their cutoff is
+  // gainBandwidth times the host sample rate, 12 dB per octave above it, so
+  // the gain is only about 14 dB down at the host Nyquist frequency. That
+  // reduces, but does not remove, what the product of a gain computed at 1x
+  // and audio oversampled by 2x aliases back into the host band: the
+  // benchmark, with --aliasing, checks it against full rate oversampling.
+  static constexpr double gainBandwidth = 0.25;
+  Float gainLowPassCoef = Float(0);
+
+  void setGainBandLimit(bool const isEnabled, int const oversamplingRate)
+  {
+    constexpr double twoPi = 6.283185307179586476925;
+    gainLowPassCoef =
+      isEnabled
+        ? Float(1.0 - std::exp(-twoPi * gainBandwidth / oversamplingRate))
+        : Float(0);
+  }
+
+  // Links the lanes in the mask with equal weights. Fewer than two lanes in
+  // the mask disable the bus link.
+  void setBusLinkGroup(unsigned const laneMask);
+
+  // Multiband: every band has its own Dsp, with its own curve and envelope
+  // follower. Copies from the Dsp of another band the settings all the bands
+  // share: links, feedback amount, high-pass, smoothing, detector rate, gain
+  // band limit and lookahead. No state is copied.
+  void copySharedSettings(TDsp const& other);
+
+  // Gain computer table: the spline minus its input, per lane, sampled on
+  // gainTableSize points over the knot range of SplineParameters. It is
+  // rebuilt a slice per block once the knot targets stop changing and their
+  // smoothing has settled, which it only does while the spline kernels run.
+  // The spline is then set to its targets, so the table is built from them
+  // and the spline picks up from them when the targets change again. While
+  // the table is complete, the kernels interpolate it instead of evaluating
+  // the spline, so their cost no longer depends on the number of knots.
+
+  static constexpr int gainTableSize = 1024;
+  static constexpr int gainTablePointsPerBlock = 128;
+  static constexpr double gainTableMinDb = -96.0;
+  static constexpr double gainTableMaxDb = 6.0;
+
+  Float gainTable[gainTableSize * numLanes];
+  typename adsp::Spline<Vec, maxNumKnots>::SmoothingAutomator gainTableTargets;
+  int gainTableNumKnots = 0;
+  int gainTableNumPoints = 0;
+  double gainTableSettlingSamples = 0.0;
+
+  bool isGainTableReady() const { return gainTableNumPoints == gainTableSize; }
+
+  // to be called once per block, after the knot targets have been updated
+  void updateGainTable(int const numActiveKnots);
+
+  void resetGainTable();
+
+  TDsp()
+  {
+    AVEC_ASSERT_ALIGNMENT(this, Vec);
+    std::fill_n(stereoLink, numLanes * 17, Float(0));
+    std::fill_n(splitRateGain, numLanes * 3, Float(1));
+    automationAlpha = controlAlpha = busLinkTarget = Float(0);
+    setBusLinkGroup(0);
+    resetGainTable();
+  }
+
+  // numActiveKnots and highPassOrder select a kernel specialized on both at
+  // compile time (see CurvessorDsp.cpp), so they are read once per block, as
+  // are whether the lookahead, the gain band limit and the bus link are on.
+  // When the gain table is ready, numActiveKnots is ignored. With no active
+  // knot the audio is only delayed by the lookahead.
+
+  void forwardProcess(VecBuffer<Vec>& io,
                       int const numActiveKnots,
                       int const highPassOrder);
 
-  void feedbackProcess(VecBuffer<Vec2d>& io,
+  void feedbackProcess(VecBuffer<Vec>& io,
                        int const numActiveKnots,
                        int const highPassOrder);
 
-  void sidechainProcess(VecBuffer<Vec2d>& io,
-                        VecBuffer<Vec2d>& sidechain,
+  void sidechainProcess(VecBuffer<Vec>& io,
+                        VecBuffer<Vec>& sidechain,
                         int const numActiveKnots,
                         int const highPassOrder);
 };
 
+extern template struct TDsp<Vec2d>;
+extern template struct TDsp<Vec8d>;
+extern template struct TDsp<Vec4f>;
+extern template struct TDsp<Vec8f>;
+
+using Dsp = TDsp<Vec2d>;
+
 } // namespace curvessor
@@ -0,0 +1,100 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Curvessor.
+
+Curvessor is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Curvessor is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Curvessor.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// Fractional delay for a planar block of up to Vec::size() channels, read
+// back as interleaved SIMD frames (channel c in lane c, like the interleaved
+// oversampling buffers). Used to align the dry signal with the latency of the
+// wet oversampling without running it through a second oversampler.
+
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace curvessor {
+
+template<class Vec>
+class DryDelay final
+{
+public:
+  using Float = std::remove_cvref_t<decltype(std::declval<Vec const&>()[0])>;
+  static constexpr int numLanes = Vec::size();
+
+  void prepare(int const maxDelay_, int const maxBlockSize)
+  {
+    int size = 1;
+    while (size < maxDelay_ + maxBlockSize + 2) {
+      size <<= 1;
+    }
+    ring.assign(size, Vec(Float(0)));
+    output.assign(maxBlockSize, Vec(Float(0)));
+    mask = size - 1;
+    writeIndex = 0;
+    maxDelay = maxDelay_;
+  }
+
+  void reset() { std::fill(ring.begin(), ring.end(), Vec(Float(0))); }
+
+  bool canProcess(double const delay, int const numSamples) const
+  {
+    return delay >= 0.0 && delay <= maxDelay &&
+           numSamples <= static_cast<int>(output.size());
+  }
+
+  // Pushes numSamples frames and returns them delayed by delay samples,
+  // linearly interpolated. Valid until the next call.
+  Vec const* process(Float const* const* input,
+                     int const numChannels,
+                     int const numSamples,
+                     double const delay)
+  {
+    int const integerDelay = static_cast<int>(delay);
+    auto const fraction = Vec(Float(delay - integerDelay));
+
+    Float frame[numLanes] = {};
+    for (int i = 0; i < numSamples; ++i) {
+      for (int c = 0; c < numChannels; ++c) {
+        frame[c] = input[c][i];
+      }
+      ring[(writeIndex + i) & mask] = Vec().load(frame);
+    }
+
+    for (int i = 0; i < numSamples; ++i) {
+      int const readIndex = writeIndex + i - integerDelay;
+      Vec const current = ring[readIndex & mask];
+      Vec const previous = ring[(readIndex - 1) & mask];
+      output[i] = current + fraction * (previous - current);
+    }
+
+    writeIndex = (writeIndex + numSamples) & mask;
+
+    return output.data();
+  }
+
+private:
+  std::vector<Vec> ring;
+  std::vector<Vec> output;
+  int mask = 0;
+  int writeIndex = 0;
+  int maxDelay = 0;
+};
+
+} // namespace curvessor
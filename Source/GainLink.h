@@ -0,0 +1,181 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Curvessor.
+
+Curvessor is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Curvessor is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Curvessor.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// Gain link: an instance sending on a channel publishes the output of its
+// gain computer, in dB and at the host sample rate, and the instances
+// receiving on that channel apply it instead of running their own detection.
+// Channels are process wide, so only instances loaded in the same process
+// (and from the same plugin binary) can be linked.
+//
+// Each channel is a ring of stereo frames with a single writer, claimed by
+// the sending instance, and any number of readers. A reader takes the latest
+// frames written, so it is aligned with the sender when the host processes
+// the sender first, and one block late otherwise.
+//
+// The sender also publishes the latency of its gain frames: how far the audio
+// each frame applies to lags the input of the sender. A receiver delaying its
+// dry signal by its own latency reads that much less behind the last frame.
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace curvessor {
+
+class GainLink final
+{
+public:
+  static constexpr int numChannels = 8;
+  static constexpr int capacity = 1 << 15;
+
+  static GainLink& getInstance()
+  {
+    static GainLink instance;
+    return instance;
+  }
+
+  // sending
+
+  bool claim(int const channel, void const* owner)
+  {
+    void const* expected = nullptr;
+    return slots[channel].sender.compare_exchange_strong(
+      expected, owner, std::memory_order_acq_rel);
+  }
+
+  void release(int const channel, void const* owner)
+  {
+    void const* expected = owner;
+    slots[channel].sender.compare_exchange_strong(
+      expected, nullptr, std::memory_order_acq_rel);
+  }
+
+  // only by the instance that claimed the channel
+  void write(int const channel, float const* const* gainDb, int numSamples)
+  {
+    auto& slot = slots[channel];
+    int64_t const position = slot.writePosition.load(std::memory_order_relaxed);
+    for (int i = 0; i < numSamples; ++i) {
+      auto* frame = &slot.gainDb[2 * ((position + i) & mask)];
+      frame[0].store(gainDb[0][i], std::memory_order_relaxed);
+      frame[1].store(gainDb[1][i], std::memory_order_relaxed);
+    }
+    slot.writePosition.store(position + numSamples, std::memory_order_release);
+  }
+
+  // in samples at the host rate, only by the instance that claimed the channel
+  void setLatency(int const channel, double const latency)
+  {
+    slots[channel].latency.store(latency, std::memory_order_relaxed);
+  }
+
+  // receiving
+
+  double getLatency(int const channel) const
+  {
+    return slots[channel].latency.load(std::memory_order_relaxed);
+  }
+
+  struct Reader
+  {
+    int channel = -1;
+    // the write position as of the start of the block of the receiver
+    int64_t lastWritePosition = -1;
+    bool isSenderRunning = false;
+    float lastGainDb[2] = { 0.f, 0.f };
+  };
+
+  // Reads the frames of numSamples samples from offset, in a block of
+  // blockSize samples of the receiver, which may be processed in slices. The
+  // block is matched, at its first read, with the blockSize frames that end
+  // delay frames before the last one written, so that its slices read
+  // consecutive frames. While the sender is not running the last gain read is
+  // held, and with no sender the gain is 0 dB.
+  void read(int const channel,
+            Reader& reader,
+            float* const* gainDb,
+            int const offset,
+            int const numSamples,
+            int const blockSize,
+            int const delay)
+  {
+    auto& slot = slots[channel];
+
+    bool const isNewChannel = reader.channel != channel;
+    if (isNewChannel) {
+      reader = Reader{};
+      reader.channel = channel;
+    }
+
+    if (offset == 0 || isNewChannel) {
+      int64_t const position =
+        slot.writePosition.load(std::memory_order_acquire);
+      reader.isSenderRunning =
+        slot.sender.load(std::memory_order_acquire) != nullptr &&
+        position != reader.lastWritePosition;
+      reader.lastWritePosition = position;
+    }
+
+    // frames further back than half the ring may be under the writer
+    bool const isInRange = blockSize + delay <= capacity / 2;
+
+    if (!reader.isSenderRunning || !isInRange) {
+      if (slot.sender.load(std::memory_order_relaxed) == nullptr) {
+        reader.lastGainDb[0] = reader.lastGainDb[1] = 0.f;
+      }
+      for (int i = 0; i < numSamples; ++i) {
+        gainDb[0][i] = reader.lastGainDb[0];
+        gainDb[1][i] = reader.lastGainDb[1];
+      }
+      return;
+    }
+
+    int64_t const begin =
+      reader.lastWritePosition - delay - blockSize + offset;
+    for (int i = 0; i < numSamples; ++i) {
+      auto const* frame = &slot.gainDb[2 * ((begin + i) & mask)];
+      gainDb[0][i] = frame[0].load(std::memory_order_relaxed);
+      gainDb[1][i] = frame[1].load(std::memory_order_relaxed);
+    }
+
+    if (numSamples > 0) {
+      reader.lastGainDb[0] = gainDb[0][numSamples - 1];
+      reader.lastGainDb[1] = gainDb[1][numSamples - 1];
+    }
+  }
+
+private:
+  static constexpr int64_t mask = capacity - 1;
+
+  struct Slot
+  {
+    std::atomic<void const*> sender{ nullptr };
+    std::atomic<int64_t> writePosition{ 0 };
+    std::atomic<double> latency{ 0.0 };
+    std::array<std::atomic<float>, 2 * capacity> gainDb{};
+  };
+
+  GainLink() = default;
+
+  std::array<Slot, numChannels> slots;
+};
+
+} // namespace curvessor
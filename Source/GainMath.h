@@ -0,0 +1,95 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Curvessor.
+
+Curvessor is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Curvessor is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Curvessor.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// dB to linear gain conversion used by the DSP kernels on every upsampled
+// sample. Only needs the SIMD types, as it is compiled into CurvessorDsp.cpp
+// and the benchmark.
+//
+// The approximated tiers write the gain as 2^x, x = dB * log2(10) / 20, and
+// split x into round(x) + f with |f| <= 0.5. 2^round(x) is built from the
+// exponent bits (pow2n), 2^f is a minimax polynomial fitted on the relative
+// error:
+//
+// - GainAccuracy::thousandthDb: cubic, max error 0.00065 dB.
+// - GainAccuracy::hundredthDb: 2^(f/2) as a quadratic, then squared, max
+//   error 0.0038 dB. One operation shorter than the cubic.
+//
+// The tier is chosen at build time with the CURVESSOR_GAIN_ACCURACY CMake
+// cache variable.
+
+#include <type_traits>
+#include <utility>
+
+#ifndef CURVESSOR_GAIN_ACCURACY
+#define CURVESSOR_GAIN_ACCURACY 0
+#endif
+
+namespace curvessor {
+
+enum class GainAccuracy
+{
+  exact = 0,
+  thousandthDb = 1,
+  hundredthDb = 2
+};
+
+inline constexpr auto gainAccuracy =
+  static_cast<GainAccuracy>(CURVESSOR_GAIN_ACCURACY);
+
+template<GainAccuracy accuracy, class Vec>
+inline Vec
+dbToLinear(Vec db)
+{
+  using Float = std::remove_cvref_t<decltype(std::declval<Vec const&>()[0])>;
+
+  constexpr double ln10 = 2.30258509299404568402;
+  constexpr double log2_10 = 3.32192809488736234787;
+
+  if constexpr (accuracy == GainAccuracy::exact) {
+    return exp(Float(ln10 / 20.0) * db);
+  }
+  else {
+    // keeps 2^round(x) a normal number
+    constexpr Float maxExponent = std::is_same_v<Float, float> ? 126 : 1022;
+
+    Vec x = Float(log2_10 / 20.0) * db;
+    x = min(max(x, Vec(-maxExponent)), Vec(maxExponent));
+
+    Vec const n = round(x);
+    Vec const f = x - n;
+
+    if constexpr (accuracy == GainAccuracy::thousandthDb) {
+      Vec p = Float(0.055171669074864);
+      p = p * f + Float(0.2426111221943308);
+      p = p * f + Float(0.6932609854573362);
+      p = p * f + Float(0.9999280735404956);
+      return p * pow2n(n);
+    }
+    else {
+      Vec p = Float(0.2397760337267774 * 0.25);
+      p = p * f + Float(0.6957423323821299 * 0.5);
+      p = p * f + Float(1.000028057002141);
+      return (p * p) * pow2n(n);
+    }
+  }
+}
+
+} // namespace curvessor
@@ -164,6 +164,36 @@ CurvessorAudioProcessorEditor::Content::Content(CurvessorAudioProcessor& p)
   applyTableSettings(highPassCutoff);
   applyTableSettings(wet);
 
+  auto& parameters = p.getCurvessorParameters();
+
+  for (int i = 0; i < curvessor::maxNumBands - 1; ++i) {
+    upperBands[i] =
+      std::make_unique<BandEditors>(*parameters.upperBands[i].spline,
+                                    parameters.upperBands[i].envelopeFollower,
+                                    *parameters.apvts);
+    auto& band = *upperBands[i];
+    addChildComponent(band.spline);
+    addChildComponent(band.selectedKnot);
+    addChildComponent(band.gammaEnv);
+    band.spline.xSuffix = "dB";
+    band.spline.ySuffix = "dB";
+    attachAndInitializeSplineEditors(band.spline, band.selectedKnot, 3);
+    band.gammaEnv.setTableSettings(tableSettings);
+    band.selectedKnot.setTableSettings(tableSettings);
+    for (int c = 0; c < 2; ++c) {
+      band.spline.vuMeter[c] = &processor.levelVuMeterResults[c];
+    }
+  }
+
+  for (int band = 0; band < curvessor::maxNumBands; ++band) {
+    bandSelector.addItem("Band " + String(band + 1), band + 1);
+  }
+  bandSelector.setSelectedId(1, dontSendNotification);
+  bandSelector.onChange = [this] {
+    showBand(bandSelector.getSelectedId() - 1);
+  };
+  addAndMakeVisible(bandSelector);
+
   for (int c = 0; c < 2; ++c) {
     outputGain.getControl(c).setTextValueSuffix("dB");
     inputGain.getControl(c).setTextValueSuffix("dB");
@@ -186,6 +216,10 @@ CurvessorAudioProcessorEditor::Content::Content(CurvessorAudioProcessor& p)
   url.setText("www.unevens.net", dontSendNotification);
   url.setJustification(Justification::left);
 
+#if CURVESSOR_PROFILING
+  addAndMakeVisible(profilingView);
+#endif
+
   setSize(kDesignWidth, kDesignHeight);
 }
 
@@ -231,22 +265,53 @@ CurvessorAudioProcessorEditor::Content::paint(Graphics& g)
 }
 
 void
-CurvessorAudioProcessorEditor::Content::resized()
+CurvessorAudioProcessorEditor::Content::showBand(int band)
 {
-  spline.setTopLeftPosition(offset + 1, offset + 1);
-  spline.setSize(splineEditorSide - 2, splineEditorSide - 2);
-
-  vuMeter.setTopLeftPosition(splineEditorSide + 2 * offset, offset);
-  vuMeter.setSize(vuMeterWidth, splineEditorSide);
-
-  selectedKnot.setTopLeftPosition(offset, splineEditorSide + 2 * offset);
-  selectedKnot.setSize(splineEditorSide + offset + vuMeterWidth + 2, 160._p);
+  spline.setVisible(band == 0);
+  selectedKnot.setVisible(band == 0);
+  gammaEnv.setVisible(band == 0);
+  for (int i = 0; i < curvessor::maxNumBands - 1; ++i) {
+    upperBands[i]->spline.setVisible(band == i + 1);
+    upperBands[i]->selectedKnot.setVisible(band == i + 1);
+    upperBands[i]->gammaEnv.setVisible(band == i + 1);
+  }
+}
 
+void
+CurvessorAudioProcessorEditor::Content::resized()
+{
   constexpr auto gammaEnvEditorY =
     splineEditorSide + knotEditorHeight + 3 * offset;
 
-  gammaEnv.setTopLeftPosition(offset, gammaEnvEditorY);
-  gammaEnv.setSize(gammaEnv.fullSizeWidth * uiGlobalScaleFactor, rowHeight * 4);
+  // the editors of all the bands overlap
+  auto const layoutBand = [&](SplineEditor& splineEditor,
+                              SplineKnotEditor& knotEditor,
+                              GammaEnvEditor& gammaEnvEditor) {
+    splineEditor.setTopLeftPosition(offset + 1, offset + 1);
+    splineEditor.setSize(splineEditorSide - 2, splineEditorSide - 2);
+
+    knotEditor.setTopLeftPosition(offset, splineEditorSide + 2 * offset);
+    knotEditor.setSize(splineEditorSide + offset + vuMeterWidth + 2, 160._p);
+
+    gammaEnvEditor.setTopLeftPosition(offset, gammaEnvEditorY);
+    gammaEnvEditor.setSize(gammaEnvEditor.fullSizeWidth * uiGlobalScaleFactor,
+                           rowHeight * 4);
+
+    auto const knotsTop = splineEditor.getPosition().y;
+    splineEditor.areaInWhichToDrawKnots =
+      juce::Rectangle<int>(splineEditor.getPosition().x,
+                           knotsTop,
+                           jmax(splineEditor.getWidth(), knotEditor.getWidth()),
+                           knotEditor.getBottom() - knotsTop);
+  };
+
+  layoutBand(spline, selectedKnot, gammaEnv);
+  for (auto& band : upperBands) {
+    layoutBand(band->spline, band->selectedKnot, band->gammaEnv);
+  }
+
+  vuMeter.setTopLeftPosition(splineEditorSide + 2 * offset, offset);
+  vuMeter.setSize(vuMeterWidth, splineEditorSide);
 
   highPassLabelFirsLine.setTopLeftPosition(gainLeft, highPassTop + 10._p);
   highPassLabelFirsLine.setSize(136._p, rowHeight);
@@ -336,13 +401,93 @@ CurvessorAudioProcessorEditor::Content::resized()
   url.setTopLeftPosition(10._p, getHeight() - 18._p);
   url.setSize(160._p, 16._p);
 
-  spline.areaInWhichToDrawKnots =
-    juce::Rectangle<int>(spline.getPosition().x,
-                         spline.getPosition().y,
-                         jmax(spline.getWidth(), selectedKnot.getWidth()),
-                         selectedKnot.getBottom() - spline.getPosition().y);
+  bandSelector.setTopLeftPosition(180._p, getHeight() - 20._p);
+  bandSelector.setSize(90._p, 18._p);
+
+#if CURVESSOR_PROFILING
+  profilingView.setTopLeftPosition(280._p, getHeight() - 18._p);
+  profilingView.setSize(getWidth() - 290._p, 16._p);
+#endif
 }
 
+#if CURVESSOR_PROFILING
+
+CurvessorAudioProcessorEditor::ProfilingView::ProfilingView(
+  curvessor::BlockProfiler& profiler)
+  : profiler(profiler)
+{
+  setFont(Font(12._p));
+  setColour(Label::textColourId, Colours::white.withAlpha(0.6f));
+
+  if (JUCEApplicationBase::isStandaloneApp()) {
+    auto const file = File::getSpecialLocation(File::tempDirectory)
+                        .getChildFile("CurvessorProfile.csv");
+    file.deleteFile();
+    csv = file.createOutputStream();
+    if (csv) {
+      *csv << "samples";
+      for (auto const* name : curvessor::profilingStageNames) {
+        *csv << "," << name;
+      }
+      *csv << "\n";
+    }
+  }
+
+  startTimer(250);
+}
+
+void
+CurvessorAudioProcessorEditor::ProfilingView::timerCallback()
+{
+  auto timings = curvessor::BlockTimings{};
+
+  while (profiler.pop(timings)) {
+    if (timings.numSamples == 0) {
+      continue;
+    }
+    numSamples += timings.numSamples;
+    for (int s = 0; s < curvessor::numProfilingStages; ++s) {
+      totalNs[s] += timings.ns[s];
+      worstNsPerSample[s] = std::max(
+        worstNsPerSample[s], static_cast<double>(timings.ns[s]) /
+                               timings.numSamples);
+    }
+    if (csv) {
+      *csv << timings.numSamples;
+      for (auto const ns : timings.ns) {
+        *csv << "," << static_cast<int>(ns);
+      }
+      *csv << "\n";
+    }
+  }
+
+  if (++numTicks < 4) {
+    return;
+  }
+
+  if (csv) {
+    csv->flush();
+  }
+
+  auto text = String("ns/sample (mean/worst)");
+  double total = 0.0;
+  for (int s = 0; s < curvessor::numProfilingStages; ++s) {
+    double const mean = numSamples > 0.0 ? totalNs[s] / numSamples : 0.0;
+    total += mean;
+    text << "  " << curvessor::profilingStageNames[s] << " "
+         << String(mean, 1) << "/" << String(worstNsPerSample[s], 1);
+  }
+  text << "  total " << String(total, 1);
+  setText(text, dontSendNotification);
+
+  totalNs.fill(0.0);
+  worstNsPerSample.fill(0.0);
+  numSamples = 0.0;
+  numTicks = 0;
+}
+
+#endif
+
 CurvessorAudioProcessorEditor::CurvessorAudioProcessorEditor(
   CurvessorAudioProcessor& p)
   : AudioProcessorEditor(&p)
@@ -34,6 +34,26 @@ public:
   void resized() override;
 
 private:
+#if CURVESSOR_PROFILING
+  // Mean and worst ns/sample of each stage of the processing over the last
+  // second. In the standalone app every block is also appended to
+  // CurvessorProfile.csv in the temporary directory.
+  struct ProfilingView
+    : public Label
+    , private Timer
+  {
+    ProfilingView(curvessor::BlockProfiler& profiler);
+    void timerCallback() override;
+
+    curvessor::BlockProfiler& profiler;
+    std::unique_ptr<FileOutputStream> csv;
+    std::array<double, curvessor::numProfilingStages> totalNs{};
+    std::array<double, curvessor::numProfilingStages> worstNsPerSample{};
+    double numSamples = 0.0;
+    int numTicks = 0;
+  };
+#endif
+
   // The whole UI lives in design coordinates inside `Content`. The outer
   // editor scales it via setTransform on resize, so child components and the
   // juicy submodule never learn about runtime scaling.
@@ -70,6 +90,33 @@ private:
     Label highPassLabelFirsLine{ {}, "Detector" };
     Label highPassLabelSecondLine{ {}, "High Pass" };
     TextEditor url;
+#if CURVESSOR_PROFILING
+    ProfilingView profilingView{ processor.getProfiler() };
+#endif
+
+    // the curve and envelope editors of the bands above the first one, the
+    // ones of the first band being spline, selectedKnot and gammaEnv; only
+    // the ones of the band picked in bandSelector are shown
+    struct BandEditors
+    {
+      BandEditors(SplineParameters& splineParameters,
+                  GammaEnvParameters& envelopeFollower,
+                  AudioProcessorValueTreeState& apvts)
+        : spline(splineParameters, apvts)
+        , selectedKnot(splineParameters, apvts)
+        , gammaEnv(apvts, envelopeFollower)
+      {}
+
+      SplineEditor spline;
+      SplineKnotEditor selectedKnot;
+      GammaEnvEditor gammaEnv;
+    };
+
+    std::array<std::unique_ptr<BandEditors>, curvessor::maxNumBands - 1>
+      upperBands;
+    ComboBox bandSelector;
+
+    void showBand(int band);
 
     Colour lineColour = Colours::white;
     Colour backgroundColour = Colours::black.withAlpha(0.6f);
@@ -92,6 +92,8 @@ CurvessorAudioProcessor::Parameters::Parameters(
 
   sideChain = createBoolParameter("SideChain", false);
 
+  singlePrecision = createBoolParameter("Single-Precision", false);
+
   oversampling = { static_cast<RangedAudioParameter*>(createChoiceParameter(
                      "Oversampling", { "1x", "2x", "4x", "8x", "16x", "32x" })),
                    createWrappedBoolParameter("Linear-Phase-Oversampling",
@@ -108,48 +110,122 @@ CurvessorAudioProcessor::Parameters::Parameters(
   feedbackAmount =
     createLinkableFloatParameters("Feedback-Amount", 0.f, 0.f, 100.f, 1.f);
 
-  envelopeFollower.attack =
-    createLinkableFloatParameters("Attack", 20.f, 0.05f, 2000.f, 0.01f, 0.25f);
+  // the parameters of the first band have no prefix
+  auto const createEnvelopeFollowerParameters = [&](String prefix) {
+    GammaEnvParameters envelope;
+
+    envelope.attack = createLinkableFloatParameters(
+      prefix + "Attack", 20.f, 0.05f, 2000.f, 0.01f, 0.25f);
+
+    envelope.release = createLinkableFloatParameters(
+      prefix + "Release", 200.f, 1.f, 2000.f, 0.01f, 0.25f);
 
-  envelopeFollower.release =
-    createLinkableFloatParameters("Release", 200.f, 1.f, 2000.f, 0.01f, 0.25f);
+    envelope.attackDelay =
+      createLinkableFloatParameters(prefix + "Attack-Delay", 0.f, 0.f, 25.f);
 
-  envelopeFollower.attackDelay =
-    createLinkableFloatParameters("Attack-Delay", 0.f, 0.f, 25.f);
+    envelope.releaseDelay =
+      createLinkableFloatParameters(prefix + "Release-Delay", 0.f, 0.f, 25.f);
 
-  envelopeFollower.releaseDelay =
-    createLinkableFloatParameters("Release-Delay", 0.f, 0.f, 25.f);
+    envelope.rmsTime = createLinkableFloatParameters(
+      prefix + "RMS-Time", 0.f, 0.f, 1000.f, 0.01f, 0.25f);
+
+    return envelope;
+  };
 
-  envelopeFollower.rmsTime =
-    createLinkableFloatParameters("RMS-Time", 0.f, 0.f, 1000.f, 0.01f, 0.25f);
+  envelopeFollower = createEnvelopeFollowerParameters("");
 
   stereoLink = createFloatParameter("Stereo-Link", 50.f, 0.f, 100.f, 1.f);
 
+  busLink = createFloatParameter("Bus-Link", 50.f, 0.f, 100.f, 1.f);
+
   highPassCutoff =
     createLinkableFloatParameters("High-Pass-Cutoff", 100.f, 10.f, 250.f);
 
   highPassOrder = createChoiceParameter(
     "High-Pass-Order", { "Disabled", "6dB/Oct", "12db/Oct", "18dB/Oct" });
 
+  dryPath =
+    createChoiceParameter("Dry-Path", { "Auto", "Delay", "Phase-Compensated" });
+
+  detectorRate =
+    createChoiceParameter("Detector-Rate", { "Oversampled", "2x", "1x" });
+
+  bandLimitedGain = createBoolParameter("Band-Limited-Gain", false);
+
+  lookahead = createFloatParameter(
+    "Lookahead", 0.f, 0.f, 1000.f * maxLookaheadTime, 0.01f);
+
+  gainLink = createChoiceParameter("Gain-Link", { "Off", "Send", "Receive" });
+
+  gainLinkChannel = createChoiceParameter("Gain-Link-Channel", [] {
+    StringArray channels;
+    for (int i = 1; i <= curvessor::GainLink::numChannels; ++i) {
+      channels.add(String(i));
+    }
+    return channels;
+  }());
+
   auto const isKnotActive = [](int knotIndex) {
     return knotIndex >= 3 && knotIndex <= 6;
   };
 
-  spline = std::unique_ptr<SplineParameters>(
-    new SplineParameters("",
-                         layout,
-                         CurvessorAudioProcessor::maxEditableKnots,
-                         { -96.f, 6.f, 0.01f },
-                         { -96.f, 6.f, 0.01f },
-                         { -20.f, 20.f, 0.01f },
-                         isKnotActive,
-                         { { -96.f, -96.f, 1.f, 1.f } }));
+  auto const createSplineParameters = [&](String prefix) {
+    return std::unique_ptr<SplineParameters>(
+      new SplineParameters(prefix,
+                           layout,
+                           CurvessorAudioProcessor::maxEditableKnots,
+                           { -96.f, 6.f, 0.01f },
+                           { -96.f, 6.f, 0.01f },
+                           { -20.f, 20.f, 0.01f },
+                           isKnotActive,
+                           { { -96.f, -96.f, 1.f, 1.f } }));
+  };
+
+  spline = createSplineParameters("");
+
+  numBands = createChoiceParameter("Bands", [] {
+    StringArray choices;
+    for (int i = 1; i <= curvessor::maxNumBands; ++i) {
+      choices.add(String(i));
+    }
+    return choices;
+  }());
+
+  // spread a decade apart from 200 Hz
+  for (int i = 0; i < curvessor::maxNumBands - 1; ++i) {
+    crossover[i] = createFloatParameter("Crossover-" + String(i + 1),
+                                        200.f * std::pow(10.f, float(i)),
+                                        20.f,
+                                        20000.f,
+                                        1.f,
+                                        0.25f);
+  }
+
+  for (int i = 0; i < curvessor::maxNumBands - 1; ++i) {
+    String const prefix = "Band-" + String(i + 2) + "-";
+    upperBands[i].envelopeFollower = createEnvelopeFollowerParameters(prefix);
+    upperBands[i].spline = createSplineParameters(prefix);
+  }
 
   apvts = std::unique_ptr<AudioProcessorValueTreeState>(
     new AudioProcessorValueTreeState(
       processor, nullptr, "CURVESSOR2-PARAMETERS", std::move(layout)));
 }
 
+static oversimple::OversamplingSettings
+makeOversamplingSettings()
+{
+  auto s = oversimple::OversamplingSettings{};
+  s.numUpSampledChannels = 2;
+  s.numDownSampledChannels = 2;
+  s.upSampleOutputBufferType = oversimple::BufferType::interleaved;
+  s.downSampleInputBufferType = oversimple::BufferType::interleaved;
+  s.downSampleOutputBufferType = oversimple::BufferType::interleaved;
+  s.order = 1;
+  s.isUsingLinearPhase = false;
+  return s;
+}
+
 CurvessorAudioProcessor::CurvessorAudioProcessor()
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -161,34 +237,18 @@ CurvessorAudioProcessor::CurvessorAudioProcessor()
 
   , parameters(*this)
 
-  , dsp(Aligned<curvessor::Dsp>::make())
-
-  , envelopeFollowerSettings(dsp->envelopeFollower)
-
-  , oversamplingSettings([] {
-    auto s = oversimple::OversamplingSettings{};
-    s.numUpSampledChannels = 2;
-    s.numDownSampledChannels = 2;
-    s.upSampleOutputBufferType = oversimple::BufferType::interleaved;
-    s.downSampleInputBufferType = oversimple::BufferType::interleaved;
-    s.downSampleOutputBufferType = oversimple::BufferType::interleaved;
-    s.order = 1;
-    s.isUsingLinearPhase = false;
-    return s;
-  }())
-
-  , wetOversampling(oversamplingSettings)
-  , dryOversampling(oversamplingSettings)
-  , sidechainOversampling(oversamplingSettings)
-
-  , oversamplingAttachments(
-      parameters.oversampling,
-      *parameters.apvts,
-      this,
-      &oversamplingSettings,
-      &oversamplingMutex,
-      { &wetOversampling, &dryOversampling, &sidechainOversampling })
+  , oversamplingSettings(makeOversamplingSettings())
 {
+  maxNumInputSamples.store(oversamplingSettings.maxNumInputSamples);
+  updateOversampling();
+
+  parameters.apvts->addParameterListener("Oversampling", this);
+  parameters.apvts->addParameterListener("Linear-Phase-Oversampling", this);
+
+  oversamplingBuilder.startThread();
+
+  startTimer(latencyPollingIntervalMs);
+
   levelVuMeterResults[0].store(-500.f);
   levelVuMeterResults[1].store(-500.f);
   gainVuMeterResults[0].store(0.f);
@@ -204,38 +264,292 @@ CurvessorAudioProcessor::CurvessorAudioProcessor()
 void
 CurvessorAudioProcessor::prepareToPlay(double sampleRate, int samplesPerBlock)
 {
-  dryBuffer.setNumSamples(samplesPerBlock);
+  updateChannelLayout();
+
+  bool const isMultichannel = numMainChannels != 2;
+
+  // only the chains of the current bus layout get their buffers
+  auto const prepareChain = [&](auto& chain, bool const isUsed) {
+    using ChainType = std::remove_reference_t<decltype(chain)>;
+    using Vec = typename ChainType::Vec;
+    using Float = typename ChainType::Dsp::Float;
+    int const numSamples = isUsed ? samplesPerBlock : 0;
+    chain.dryBuffer.setNumSamples(numSamples);
+    chain.dryDelay.prepare(isUsed ? maxDryDelay : 0, numSamples);
+    chain.silence.assign(numSamples, 0);
+    chain.gainOutput.assign(numSamples, Vec(Float(0)));
+    chain.linkedGain.assign(2 * numSamples, 0.f);
+
+    int ringSize = 1;
+    if (isUsed) {
+      auto const maxLookahead = static_cast<int>(
+        std::ceil(maxLookaheadTime * sampleRate * maxOversamplingRate));
+      while (ringSize <= maxLookahead) {
+        ringSize <<= 1;
+      }
+    }
+    auto const prepareLookahead = [&](auto& dsp, auto& lookaheadRing) {
+      lookaheadRing.assign(isUsed ? ringSize : 0, Vec(Float(0)));
+      dsp.lookaheadRing = isUsed ? lookaheadRing.data() : nullptr;
+      dsp.lookaheadMask = isUsed ? ringSize - 1 : 0;
+      dsp.lookaheadWriteIndex = 0;
+    };
 
-  floatToDouble = AudioBuffer<double>(4, samplesPerBlock);
+    prepareLookahead(*chain.dsp, chain.lookaheadRing);
 
-  {
-    auto const guard = std::lock_guard<std::recursive_mutex>(oversamplingMutex);
-    auto const maxIn = static_cast<uint32_t>(samplesPerBlock);
-    oversamplingSettings.maxNumInputSamples = maxIn;
-    wetOversampling.prepareBuffers(maxIn);
-    dryOversampling.prepareBuffers(maxIn);
-    sidechainOversampling.prepareBuffers(maxIn);
-  }
+    // the bands hold the upsampled signal at the highest oversampling rate
+    for (auto& band : chain.upperBands) {
+      band.io.setNumSamples(numSamples * maxOversamplingRate);
+      band.sidechain.setNumSamples(numSamples * maxOversamplingRate);
+      prepareLookahead(*band.dsp, band.lookaheadRing);
+    }
+  };
+
+  prepareChain(doubleChain, !isMultichannel);
+  prepareChain(floatChain, !isMultichannel);
+  prepareChain(multichannelDoubleChain, isMultichannel);
+  prepareChain(multichannelFloatChain, isMultichannel);
+
+  floatToDouble = AudioBuffer<double>(
+    jmax(getTotalNumInputChannels(), getTotalNumOutputChannels()),
+    samplesPerBlock);
+
+  preparedBlockSize = samplesPerBlock;
+
+  // the oversamplers follow the block size and the bus layout
+  maxNumInputSamples.store(static_cast<uint32_t>(samplesPerBlock));
+  isSideChainConnected.store(getTotalNumInputChannels() ==
+                             2 * numMainChannels);
+  isMultichannelLayout.store(isMultichannel);
+  updateOversampling();
+
+  auto const& wetOversampling = isMultichannel
+                                  ? *multichannelDoubleChain.wetOversampling
+                                  : *doubleChain.wetOversampling;
+  int const latency =
+    static_cast<int>(std::lround(wetOversampling.getLatency())) +
+    getLookaheadSamples();
+  latencySamples.store(latency);
+  setLatencySamples(latency);
 
   reset();
 }
 
+std::unique_ptr<CurvessorAudioProcessor::OversamplingEngine>
+CurvessorAudioProcessor::makeOversamplingEngine() const
+{
+  // read the generation first, an engine mixing an old generation with newer
+  // settings is just discarded
+  int const generation = oversamplingGeneration.load();
+
+  auto settings = makeOversamplingSettings();
+  settings.maxNumInputSamples = maxNumInputSamples.load();
+
+  auto& apvts = *parameters.apvts;
+  settings.order =
+    static_cast<int>(apvts.getRawParameterValue("Oversampling")->load());
+  settings.isUsingLinearPhase =
+    apvts.getRawParameterValue("Linear-Phase-Oversampling")->load() > 0.5f;
+
+  return std::make_unique<OversamplingEngine>(settings,
+                                              generation,
+                                              isMultichannelLayout.load(),
+                                              isSideChainConnected.load());
+}
+
+void
+CurvessorAudioProcessor::updateOversampling()
+{
+  // anything built or published before now is stale, and a pending request
+  // is served here
+  ++oversamplingGeneration;
+  isOversamplingChangeRequested.store(false);
+  delete pendingOversampling.exchange(nullptr);
+  oversamplingFade = OversamplingFade::none;
+  oversamplingFadeInDelay = 0;
+
+  auto engine = makeOversamplingEngine();
+  oversamplingSettings = engine->settings;
+  engine->swapInto(*this);
+}
+
+static bool
+areMirroredChannels(AudioChannelSet::ChannelType const a,
+                    AudioChannelSet::ChannelType const b)
+{
+  using C = AudioChannelSet;
+  constexpr C::ChannelType pairs[][2] = {
+    { C::left, C::right },
+    { C::leftCentre, C::rightCentre },
+    { C::leftSurround, C::rightSurround },
+    { C::leftSurroundSide, C::rightSurroundSide },
+    { C::leftSurroundRear, C::rightSurroundRear },
+    { C::wideLeft, C::wideRight },
+    { C::topFrontLeft, C::topFrontRight },
+    { C::topSideLeft, C::topSideRight },
+    { C::topRearLeft, C::topRearRight },
+  };
+  for (auto const& pair : pairs) {
+    if (a == pair[0] && b == pair[1]) {
+      return true;
+    }
+  }
+  // discrete layouts have no known geometry, their pairs are linked
+  return a >= C::discreteChannel0 && b >= C::discreteChannel0;
+}
+
+void
+CurvessorAudioProcessor::updateChannelLayout()
+{
+  auto const channels = getChannelLayoutOfBus(true, 0);
+  numMainChannels = jlimit(2, maxNumChannels, channels.size());
+
+  stereoLinkLaneMask = 0;
+  busLinkLaneMask = 0;
+
+  for (int c = 0; c < numMainChannels; ++c) {
+    auto const type = channels.getTypeOfChannel(c);
+    if (type != AudioChannelSet::LFE && type != AudioChannelSet::LFE2) {
+      busLinkLaneMask |= 1u << c;
+    }
+  }
+
+  if (numMainChannels == 2) {
+    stereoLinkLaneMask = 0b11;
+    return;
+  }
+
+  for (int c = 0; c + 1 < numMainChannels; c += 2) {
+    if (areMirroredChannels(channels.getTypeOfChannel(c),
+                            channels.getTypeOfChannel(c + 1))) {
+      stereoLinkLaneMask |= 0b11u << c;
+    }
+  }
+}
+
+void
+CurvessorAudioProcessor::parameterChanged(const String& parameterID,
+                                          float newValue)
+{
+  // may be called on the audio thread, the builder polls the flag
+  isOversamplingChangeRequested.store(true);
+}
+
+void
+CurvessorAudioProcessor::OversamplingBuilder::run()
+{
+  while (!threadShouldExit()) {
+    wait(20);
+
+    delete processor.retiredOversampling.exchange(nullptr);
+
+    if (processor.isOversamplingChangeRequested.exchange(false)) {
+      auto engine = processor.makeOversamplingEngine();
+      // an engine the audio thread did not pick up yet is superseded
+      delete processor.pendingOversampling.exchange(engine.release());
+    }
+  }
+}
+
+void
+CurvessorAudioProcessor::beginOversamplingSwap()
+{
+  switch (oversamplingFade) {
+    case OversamplingFade::none:
+      // the retired engine must be collected before a new one can be taken
+      if (pendingOversampling.load() && !retiredOversampling.load()) {
+        oversamplingFade = OversamplingFade::out;
+      }
+      break;
+
+    case OversamplingFade::out: {
+      // the previous block faded out, the swap is silent
+      auto* engine = pendingOversampling.exchange(nullptr);
+      if (engine) {
+        if (engine->generation == oversamplingGeneration.load()) {
+          oversamplingSettings = engine->settings;
+          engine->swapInto(*this);
+          // the other chains are reset when switched to, see useChain
+          auto const resetChainInUse = [&](auto& chain) {
+            if (lastChain == &chain) {
+              resetChain(chain, true);
+              chain.isOversamplingSwapped = true;
+            }
+          };
+          resetChainInUse(doubleChain);
+          resetChainInUse(floatChain);
+          resetChainInUse(multichannelDoubleChain);
+          resetChainInUse(multichannelFloatChain);
+        }
+        retiredOversampling.store(engine);
+      }
+      oversamplingFade = OversamplingFade::in;
+    } break;
+
+    case OversamplingFade::in:
+      break;
+  }
+}
+
+template<class FloatType>
+void
+CurvessorAudioProcessor::applyOversamplingFade(AudioBuffer<FloatType>& buffer)
+{
+  if (oversamplingFade == OversamplingFade::none) {
+    return;
+  }
+
+  int const numSamples = buffer.getNumSamples();
+  bool const isFadingOut = oversamplingFade == OversamplingFade::out;
+
+  // the fade in waits for the new oversamplers to fill up when the delayed
+  // dry signal could not cover for them, see process
+  int const silence =
+    isFadingOut ? 0 : std::min(oversamplingFadeInDelay, numSamples);
+  oversamplingFadeInDelay -= silence;
+
+  int const fadeLength =
+    jlimit(0,
+           numSamples - silence,
+           static_cast<int>(oversamplingFadeTime * getSampleRate()));
+
+  // the fade out ends the block, so that with the fade in starting the next
+  // one the swap dips for two fade times whatever the block size
+  for (int c = 0; c < getTotalNumOutputChannels(); ++c) {
+    if (isFadingOut) {
+      buffer.applyGainRamp(c, numSamples - fadeLength, fadeLength, 1.f, 0.f);
+      continue;
+    }
+    buffer.clear(c, 0, silence);
+    if (fadeLength > 0) {
+      buffer.applyGainRamp(c, silence, fadeLength, 0.f, 1.f);
+    }
+  }
+
+  if (!isFadingOut && silence < numSamples) {
+    oversamplingFade = OversamplingFade::none;
+  }
+}
+
+template void
+CurvessorAudioProcessor::applyOversamplingFade(AudioBuffer<double>&);
+
 #ifndef JucePlugin_PreferredChannelConfigurations
 bool
 CurvessorAudioProcessor::isBusesLayoutSupported(
   const BusesLayout& layouts) const
 {
-  if (layouts.getMainOutputChannels() != 2) {
+  // any layout from stereo to maxNumChannels, the same on input and output
+  auto const main = layouts.getMainInputChannelSet();
+  if (main != layouts.getMainOutputChannelSet()) {
     return false;
   }
-  if (layouts.getMainInputChannels() != 2) {
+  if (main.size() < 2 || main.size() > maxNumChannels) {
     return false;
   }
+  // the sidechain is either off or as wide as the main bus
   int const sidechainChannels = layouts.getNumChannels(true, 1);
-  if (sidechainChannels == 2 || sidechainChannels == 0) {
-    return true;
-  }
-  return false;
+  return sidechainChannels == 0 || sidechainChannels == main.size();
 }
 #endif
 
@@ -243,28 +557,34 @@ void
 CurvessorAudioProcessor::processBlock(AudioBuffer<float>& buffer,
                                       MidiBuffer& midiMessages)
 {
-  auto const totalNumInputChannels = getTotalNumInputChannels();
-  auto const numSamples = buffer.getNumSamples();
+  curvessor::ScopedAllocationCheck const allocationCheck;
 
-  floatToDouble.setSize(4, numSamples, false, false, true);
+  beginOversamplingSwap();
 
-  for (int c = 0; c < totalNumInputChannels; ++c) {
-    std::copy(buffer.getReadPointer(c),
-              buffer.getReadPointer(c) + numSamples,
-              floatToDouble.getWritePointer(c));
-  }
+  bool const isUsingSinglePrecision = parameters.singlePrecision->get();
+  bool const isMultichannel = numMainChannels != 2;
 
-  for (int c = totalNumInputChannels; c < 4; ++c) {
-    floatToDouble.clear(c, 0, numSamples);
+  if (isUsingSinglePrecision) {
+    if (isMultichannel) {
+      processInSlices(buffer, useChain(multichannelFloatChain));
+    }
+    else {
+      processInSlices(buffer, useChain(floatChain));
+    }
+    applyOversamplingFade(buffer);
+    return;
   }
 
-  processBlock(floatToDouble, midiMessages);
-
-  for (int c = 0; c < totalNumInputChannels; ++c) {
-    std::copy(floatToDouble.getReadPointer(c),
-              floatToDouble.getReadPointer(c) + numSamples,
-              buffer.getWritePointer(c));
+  // the double chains convert from and to the host buffer as they read and
+  // write it, working in floatToDouble in between
+  if (isMultichannel) {
+    processInSlices(buffer, useChain(multichannelDoubleChain));
+  }
+  else {
+    processInSlices(buffer, useChain(doubleChain));
   }
+
+  applyOversamplingFade(buffer);
 }
 
 void
@@ -294,7 +614,58 @@ CurvessorAudioProcessor::releaseResources()
 }
 
 //==============================================================================
-CurvessorAudioProcessor::~CurvessorAudioProcessor() {}
+CurvessorAudioProcessor::~CurvessorAudioProcessor()
+{
+  parameters.apvts->removeParameterListener("Oversampling", this);
+  parameters.apvts->removeParameterListener("Linear-Phase-Oversampling", this);
+
+  oversamplingBuilder.stopThread(1000);
+  delete pendingOversampling.exchange(nullptr);
+  delete retiredOversampling.exchange(nullptr);
+
+  updateGainLinkSender(-1);
+  stopTimer();
+}
+
+void
+CurvessorAudioProcessor::updateLatency(double const latency)
+{
+  int const samples = static_cast<int>(std::lround(latency));
+  latencySamples.store(samples, std::memory_order_relaxed);
+}
+
+void
+CurvessorAudioProcessor::timerCallback()
+{
+  int const samples = latencySamples.load(std::memory_order_relaxed);
+  if (samples != getLatencySamples()) {
+    setLatencySamples(samples);
+  }
+}
+
+int
+CurvessorAudioProcessor::getLookaheadSamples() const
+{
+  return static_cast<int>(
+    std::lround(0.001 * parameters.lookahead->get() * getSampleRate()));
+}
+
+void
+CurvessorAudioProcessor::updateGainLinkSender(int const requestedChannel)
+{
+  if (requestedChannel == gainLinkSendChannel) {
+    return;
+  }
+  auto& gainLink = curvessor::GainLink::getInstance();
+  if (gainLinkSendChannel >= 0) {
+    gainLink.release(gainLinkSendChannel, this);
+  }
+  // a channel already in use by another instance is tried again next block
+  gainLinkSendChannel =
+    requestedChannel >= 0 && gainLink.claim(requestedChannel, this)
+      ? requestedChannel
+      : -1;
+}
 
 const String
 CurvessorAudioProcessor::getName() const
@@ -384,28 +755,106 @@ createPluginFilter()
   return new CurvessorAudioProcessor();
 }
 
+template<class FloatType, int numChannels>
 void
-CurvessorAudioProcessor::resetDsp()
+CurvessorAudioProcessor::resetChain(Chain<FloatType, numChannels>& chain,
+                                    bool const isKeepingDryDelay)
 {
-  parameters.spline->updateSpline(dsp->autoSpline);
+  using ChainType = Chain<FloatType, numChannels>;
+  using Vec = typename ChainType::Vec;
 
-  dsp->envelopeFollower.reset();
-  dsp->autoSpline.reset();
+  chain.controls = ControlCache{};
 
   constexpr double ln10 = 2.30258509299404568402;
   constexpr double db_to_lin = ln10 / 20.0;
 
   double const stereoLinkTarget = 0.01 * parameters.stereoLink->get();
 
-  for (int c = 0; c < 2; ++c) {
-    dsp->gainVuMeterBuffer[c] = 0.f;
-    dsp->levelVuMeterBuffer[c] = -200.0;
-    dsp->stereoLink[c] = stereoLinkTarget;
-    dsp->inputGain[c] = exp(db_to_lin * parameters.inputGain.get(c)->get());
-    dsp->outputGain[c] = exp(db_to_lin * parameters.outputGain.get(c)->get());
-    dsp->wetAmount[c] = 0.01 * parameters.wet.get(c)->get();
-    dsp->sidechainInputGain[c] = dsp->inputGain[c];
-    dsp->feedbackAmount[c] = dsp->feedbackAmountTarget[c] =
-      parameters.feedbackAmount.get(c)->get();
+  for (int band = 0; band < ChainType::maxNumBands; ++band) {
+    auto& dsp = chain.getDsp(band);
+
+    parameters.getSpline(band).updateSpline(dsp.autoSpline);
+
+    dsp.envelopeFollower.reset();
+    dsp.autoSpline.reset();
+    dsp.resetGainTable();
+
+    // even lanes follow the left/mid parameters, odd lanes the right/side
+    // ones
+    for (int c = 0; c < numChannels; ++c) {
+      int const p = c % 2;
+      bool const isStereoLinked = (stereoLinkLaneMask >> c) & 1;
+      dsp.gainVuMeterBuffer[c] = 0.f;
+      dsp.levelVuMeterBuffer[c] = -200.0;
+      dsp.stereoLink[c] = isStereoLinked ? stereoLinkTarget : 0.0;
+      dsp.busLink[c] = 0.01 * parameters.busLink->get();
+      dsp.inputGain[c] = exp(db_to_lin * parameters.inputGain.get(p)->get());
+      dsp.outputGain[c] = exp(db_to_lin * parameters.outputGain.get(p)->get());
+      dsp.wetAmount[c] = 0.01 * parameters.wet.get(p)->get();
+      dsp.sidechainInputGain[c] = dsp.inputGain[c];
+      dsp.feedbackAmount[c] = dsp.feedbackAmountTarget[c] =
+        parameters.feedbackAmount.get(p)->get();
+      dsp.splitRateGain[c] = 1.0;
+      dsp.gainLowPassState[c] = dsp.gainLowPassState2[c] = 1.0;
+    }
   }
+
+  chain.dsp->setBusLinkGroup(numChannels > 2 ? busLinkLaneMask : 0u);
+
+  chain.crossover.reset();
+  chain.sidechainCrossover.reset();
+
+  if (!isKeepingDryDelay) {
+    chain.dryDelay.reset();
+  }
+  std::fill(chain.lookaheadRing.begin(),
+            chain.lookaheadRing.end(),
+            Vec(FloatType(0)));
+  for (auto& band : chain.upperBands) {
+    std::fill(
+      band.lookaheadRing.begin(), band.lookaheadRing.end(), Vec(FloatType(0)));
+  }
+  for (auto* oversampling : { chain.wetOversampling.get(),
+                              chain.dryOversampling.get(),
+                              chain.sidechainOversampling.get() }) {
+    if (oversampling) {
+      oversampling->reset();
+    }
+  }
+  chain.wasUsingSideChain = false;
+  chain.isIdle = false;
+  chain.idleFade = 0.0;
+  chain.idleWarmUpSamples = 0;
+  chain.isOversamplingSwapped = false;
 }
+
+void
+CurvessorAudioProcessor::resetDsp()
+{
+  resetChain(doubleChain);
+  resetChain(floatChain);
+  resetChain(multichannelDoubleChain);
+  resetChain(multichannelFloatChain);
+  lastChain = nullptr;
+}
+
+template<class FloatType, int numChannels>
+CurvessorAudioProcessor::Chain<FloatType, numChannels>&
+CurvessorAudioProcessor::useChain(Chain<FloatType, numChannels>& chain)
+{
+  // the chain we switch to holds a stale state
+  if (lastChain != &chain) {
+    if (lastChain) {
+      resetChain(chain);
+    }
+    lastChain = &chain;
+  }
+  return chain;
+}
+
+template CurvessorAudioProcessor::Chain<double>&
+CurvessorAudioProcessor::useChain(Chain<double>&);
+
+template CurvessorAudioProcessor::
+  Chain<double, CurvessorAudioProcessor::maxNumChannels>&
+  CurvessorAudioProcessor::useChain(Chain<double, maxNumChannels>&);
@@ -19,12 +19,16 @@ along with Curvessor.  If not, see <https://www.gnu.org/licenses/>.
 
 #pragma once
 
+#include "AllocationCheck.h"
+#include "Crossover.h"
 #include "CurvessorDsp.h"
 #include "GammaEnvEditor.h"
-#include "OversamplingAttachments.h"
 #include "Linkables.h"
+#include "Profiling.h"
 #include "SimpleLookAndFeel.h"
 #include "SplineParameters.h"
+#include "DryDelay.h"
+#include "GainLink.h"
 #include "avec/Buffer.hpp"
 #include <JuceHeader.h>
 
@@ -39,7 +43,10 @@ constexpr static long double operator"" _p(long double px)
   return px * uiGlobalScaleFactor;
 }
 
-class CurvessorAudioProcessor : public AudioProcessor
+class CurvessorAudioProcessor
+  : public AudioProcessor
+  , private AudioProcessorValueTreeState::Listener
+  , private Timer
 {
 public:
   static constexpr int maxNumKnots = curvessor::maxNumKnots;
@@ -50,6 +57,7 @@ private:
   {
     AudioParameterBool* midSide;
     AudioParameterBool* sideChain;
+    AudioParameterBool* singlePrecision;
     LinkableParameter<AudioParameterFloat> inputGain;
     LinkableParameter<AudioParameterFloat> outputGain;
     LinkableParameter<AudioParameterFloat> wet;
@@ -57,13 +65,44 @@ private:
     LinkableParameter<AudioParameterFloat> rmsTime;
     GammaEnvParameters envelopeFollower;
     AudioParameterFloat* stereoLink;
+    AudioParameterFloat* busLink;
     AudioParameterFloat* smoothingTime;
     OversamplingParameters oversampling;
     LinkableParameter<AudioParameterFloat> highPassCutoff;
     AudioParameterChoice* highPassOrder;
+    AudioParameterChoice* dryPath;
+    AudioParameterChoice* detectorRate;
+    AudioParameterBool* bandLimitedGain;
+    AudioParameterChoice* gainLink;
+    AudioParameterChoice* gainLinkChannel;
+    AudioParameterFloat* lookahead;
+
+    // Multiband: the number of bands, and the frequencies of the crossovers
+    // between them, lowest first. envelopeFollower and spline are the ones of
+    // the first band, upperBands hold the ones of the others.
+    AudioParameterChoice* numBands;
+    std::array<AudioParameterFloat*, curvessor::maxNumBands - 1> crossover;
 
     std::unique_ptr<SplineParameters> spline;
 
+    struct Band
+    {
+      GammaEnvParameters envelopeFollower;
+      std::unique_ptr<SplineParameters> spline;
+    };
+    std::array<Band, curvessor::maxNumBands - 1> upperBands;
+
+    GammaEnvParameters& getEnvelopeFollower(int band)
+    {
+      return band == 0 ? envelopeFollower
+                       : upperBands[band - 1].envelopeFollower;
+    }
+
+    SplineParameters& getSpline(int band)
+    {
+      return band == 0 ? *spline : *upperBands[band - 1].spline;
+    }
+
     std::unique_ptr<AudioProcessorValueTreeState> apvts;
 
     Parameters(CurvessorAudioProcessor& processor);
@@ -71,24 +110,421 @@ private:
 
   Parameters parameters;
 
-  aligned_ptr<curvessor::Dsp> dsp;
+  // One processing chain per sample type and bus width. The double chains
+  // serve the double precision callback, and the single precision one when
+  // the "Single-Precision" parameter is off. Otherwise the float chains
+  // process single precision callbacks natively: the Vec4f lanes of the
+  // stereo one hold the pair in lanes 0 and 1, with lanes 2 and 3 left idle.
+  //
+  // Stereo buses use the stereo chains. Wider buses, up to maxNumChannels,
+  // use the multichannel chains, which carry all the channels in the lanes of
+  // a Vec8d or Vec8f, so that their detection can be linked sample by sample.
+
+  static constexpr int maxNumChannels = 8;
+
+  // The parameter values, and the oversampled sample rate, that the
+  // coefficients of the last block were computed from, with the coefficients
+  // that cost a transcendental function. A block only recomputes the ones
+  // whose inputs changed. NaN compares unequal to everything, so a default
+  // constructed cache recomputes them all.
+  struct ControlCache
+  {
+    static constexpr float unset = std::numeric_limits<float>::quiet_NaN();
+
+    double upsampledSampleRate = 0.0;
+    double detectorSampleRate = 0.0;
+    int numChannels = 0;
+
+    // the smoothing at the host sample rate and at the detector one
+    float smoothingTime = unset;
+    double automationAlpha = 0.0;
+    double detectorAutomationAlpha = 0.0;
+
+    // per parameter channel, the left/mid one drives the even lanes
+    struct Channel
+    {
+      float inputGainDb = unset;
+      float outputGainDb = unset;
+      float highPassCutoff = unset;
+
+      // the envelope follower settings of each band
+      struct Envelope
+      {
+        float rmsTime = unset;
+        float attack = unset;
+        float release = unset;
+        float attackDelay = unset;
+        float releaseDelay = unset;
+      };
+      std::array<Envelope, curvessor::maxNumBands> envelopes;
+
+      double inputGain = 1.0;
+      double outputGain = 1.0;
+      double highPassCoef = 0.0;
+    };
+    std::array<Channel, 2> channels;
+  };
 
-  void resetDsp();
+  template<class FloatType, int maxNumChannels_ = 2>
+  struct Chain
+  {
+    static constexpr int maxNumChannels = maxNumChannels_;
+    static constexpr bool isDouble = std::is_same_v<FloatType, double>;
+    using Vec = std::conditional_t<
+      maxNumChannels == 2,
+      std::conditional_t<isDouble, Vec2d, Vec4f>,
+      std::conditional_t<isDouble, Vec8d, Vec8f>>;
+    using Dsp = curvessor::TDsp<Vec>;
+    using Oversampling = oversimple::TOversampling<FloatType>;
+
+    aligned_ptr<Dsp> dsp;
+
+    adsp::GammaEnvSettings<Vec> envelopeFollowerSettings;
+
+    avec::Buffer<FloatType> dryBuffer{ maxNumChannels };
+
+    // feeds the lanes of the oversamplers past the channels of the bus
+    std::vector<FloatType> silence;
+
+    // the gain computer output sent on the gain link, one frame per input
+    // sample, and the gain read from it
+    std::vector<Vec> gainOutput;
+    std::vector<float> linkedGain;
+    bool wasReceivingGain = false;
+
+    // the lookahead delay of the kernel, see TDsp::lookaheadRing
+    std::vector<Vec> lookaheadRing;
+
+    // aligns the dry signal with the wet oversampling latency, see dryPath
+    curvessor::DryDelay<Vec> dryDelay;
+    bool wasDryPathDelayed = false;
+
+    std::unique_ptr<Oversampling> wetOversampling;
+    std::unique_ptr<Oversampling> dryOversampling;
+
+    // only allocated while a sidechain bus is connected, and only run while
+    // the sidechain is in use
+    std::unique_ptr<Oversampling> sidechainOversampling;
+
+    // cross-fade of the detector input from the main signal to the sidechain
+    bool wasUsingSideChain = false;
+    double sideChainFade = 1.0;
+
+    // While idle the chain only runs the dry delay. idleFade is the share of
+    // the delayed dry signal in the output, idleWarmUpSamples the number of
+    // samples the woken up oversamplers are given before fading back in.
+    bool isIdle = false;
+    double idleFade = 0.0;
+    int idleWarmUpSamples = 0;
+
+    // set when new oversamplers are swapped in, which are then warmed up the
+    // same way, see beginOversamplingSwap
+    bool isOversamplingSwapped = false;
+
+    // the inputs of the coefficients of the last block, see ControlCache
+    ControlCache controls;
+
+    // Multiband, only on the stereo chains. The upsampled signal is split by
+    // the crossover: the first band stays in place and is processed by dsp,
+    // each other band is moved to the io buffer of one of upperBands and
+    // processed by its Dsp, then the bands are added back together before
+    // the downsampling. With the sidechain, the crossover of the sidechain
+    // splits it the same way, for the detectors of the bands.
+    static constexpr int maxNumBands =
+      maxNumChannels == 2 ? curvessor::maxNumBands : 1;
+
+    struct Band
+    {
+      aligned_ptr<Dsp> dsp;
+      adsp::GammaEnvSettings<Vec> envelopeFollowerSettings;
+      VecBuffer<Vec> io;
+      VecBuffer<Vec> sidechain;
+      std::vector<Vec> lookaheadRing;
+
+      Band()
+        : dsp(Aligned<Dsp>::make())
+        , envelopeFollowerSettings(dsp->envelopeFollower)
+      {}
+    };
+
+    std::array<Band, maxNumBands - 1> upperBands;
+    curvessor::Crossover<Vec> crossover;
+    curvessor::Crossover<Vec> sidechainCrossover;
+
+    Dsp& getDsp(int band)
+    {
+      return band == 0 ? *dsp : *upperBands[band - 1].dsp;
+    }
+
+    adsp::GammaEnvSettings<Vec>& getEnvelopeFollowerSettings(int band)
+    {
+      return band == 0 ? envelopeFollowerSettings
+                       : upperBands[band - 1].envelopeFollowerSettings;
+    }
+
+    Chain()
+      : dsp(Aligned<Dsp>::make())
+      , envelopeFollowerSettings(dsp->envelopeFollower)
+    {}
+
+    // a set of oversamplers built and prepared ahead of being swapped in
+    struct Oversamplers
+    {
+      std::unique_ptr<Oversampling> wet;
+      std::unique_ptr<Oversampling> dry;
+      std::unique_ptr<Oversampling> sidechain;
+
+      // nothing is built for a chain the bus layout does not use
+      Oversamplers(oversimple::OversamplingSettings settings,
+                   bool const isUsed,
+                   bool const isSideChainConnected)
+      {
+        if (!isUsed) {
+          return;
+        }
+        settings.numUpSampledChannels = maxNumChannels;
+        settings.numDownSampledChannels = maxNumChannels;
+        wet = std::make_unique<Oversampling>(settings);
+        dry = std::make_unique<Oversampling>(settings);
+        if (isSideChainConnected) {
+          sidechain = std::make_unique<Oversampling>(settings);
+        }
+        for (auto* oversampling : { wet.get(), dry.get(), sidechain.get() }) {
+          if (oversampling) {
+            oversampling->prepareBuffers(settings.maxNumInputSamples);
+          }
+        }
+      }
+    };
+
+    void swapOversampling(Oversamplers& other)
+    {
+      std::swap(wetOversampling, other.wet);
+      std::swap(dryOversampling, other.dry);
+      std::swap(sidechainOversampling, other.sidechain);
+    }
+  };
+
+  Chain<double> doubleChain;
+  Chain<float> floatChain;
+  Chain<double, maxNumChannels> multichannelDoubleChain;
+  Chain<float, maxNumChannels> multichannelFloatChain;
+
+  // the chain that processed the last block, a chain switched to is reset
+  void const* lastChain = nullptr;
+
+  // Main bus layout, set in prepareToPlay. Lanes of a pair of mirrored
+  // channels (as left and right, or left and right surround) are stereo
+  // linked; all the channels but the LFE ones are bus linked.
+  int numMainChannels = 2;
+  unsigned stereoLinkLaneMask = 0b11;
+  unsigned busLinkLaneMask = 0b11;
 
-  adsp::GammaEnvSettings<Vec2d> envelopeFollowerSettings;
+  void updateChannelLayout();
+
+  enum class GainLinkMode
+  {
+    off,
+    send,
+    receive
+  };
+
+  // the gain link channel this instance sends on, -1 when not sending
+  int gainLinkSendChannel = -1;
+  curvessor::GainLink::Reader gainLinkReader;
+
+  // claims or releases the send channel, on the audio thread
+  void updateGainLinkSender(int requestedChannel);
+
+  // duration of the detector cross-fade when the sidechain is switched on
+  static constexpr double sideChainFadeTime = 0.01;
+
+  // duration of the output cross-fade when going idle or waking up
+  static constexpr double idleFadeTime = 0.01;
+
+  // longest wet oversampling latency the dry delay can match, in samples
+  static constexpr int maxDryDelay = 16384;
+
+  // the range of the Lookahead parameter, and the highest oversampling rate,
+  // which together size the lookahead rings
+  static constexpr double maxLookaheadTime = 0.01;
+  static constexpr int maxOversamplingRate = 32;
+
+  // the lookahead in samples at the host sample rate
+  int getLookaheadSamples() const;
+
+  enum class DryPath
+  {
+    automatic,
+    delay,
+    phaseCompensated
+  };
+
+  // the rate the detector and the gain computer run at, see
+  // TDsp::detectorDecimation: the oversampled one, twice the host sample
+  // rate, or the host sample rate
+  enum class DetectorRate
+  {
+    full,
+    twice,
+    once
+  };
 
-  avec::Buffer<double> dryBuffer{ 2 };
+  // the dry delay can be kept running, to cover for the reset oversamplers
+  template<class FloatType, int numChannels>
+  void resetChain(Chain<FloatType, numChannels>& chain,
+                  bool const isKeepingDryDelay = false);
 
-  // buffer for single precision processing call
+  void resetDsp();
+
+  // picks the chain for the bus layout and resets it if it was not in use
+  template<class FloatType, int numChannels>
+  Chain<FloatType, numChannels>& useChain(Chain<FloatType, numChannels>& chain);
+
+  // HostFloat may differ from the precision of the chain, the conversion is
+  // fused with the input and output stages
+  template<class HostFloat, class FloatType, int numChannels>
+  void process(AudioBuffer<HostFloat>& buffer,
+               Chain<FloatType, numChannels>& chain);
+
+  // Calls process on slices of at most preparedBlockSize samples, so that
+  // blocks longer than the one announced to prepareToPlay do not grow any
+  // buffer on the audio thread.
+  //
+  // The parameters are read at the start of each slice. The plugin wrappers
+  // apply the host automation between blocks, without the sample offsets of
+  // its points, so its timing still follows the block size of the host.
+  template<class HostFloat, class FloatType, int numChannels>
+  void processInSlices(AudioBuffer<HostFloat>& buffer,
+                       Chain<FloatType, numChannels>& chain);
+
+  int preparedBlockSize = 0;
+
+  // the host block processInSlices is processing, and where in it the slice
+  // given to process starts
+  int hostBlockSize = 0;
+  int sliceOffset = 0;
+
+  // stage timings of each block, see Profiling.h
+  curvessor::BlockProfiler profiler;
+
+  // the signal of the double precision chains in a single precision callback
   AudioBuffer<double> floatToDouble;
 
-  // oversampling
+  // Oversampling. Changes to the oversampling parameters are built into a new
+  // OversamplingEngine by a background thread, and published to the audio
+  // thread through pendingOversampling. The audio thread fades out at the
+  // end of a block, swaps the oversamplers of the chains with the ones of the
+  // engine, resets the chain in use, and hands the engine, now holding the
+  // old oversamplers, back to the background thread through
+  // retiredOversampling to be deleted there. The new oversamplers are then
+  // warmed up as when waking up from idle, behind the delayed dry signal,
+  // and the output fades back in at the start of the next block. When the
+  // dry delay is too short for that, the fade in waits for their latency.
+
+  // settings of the oversamplers in use, owned by the audio thread
   oversimple::OversamplingSettings oversamplingSettings;
-  oversimple::TOversampling<double> wetOversampling;
-  oversimple::TOversampling<double> dryOversampling;
-  oversimple::TOversampling<double> sidechainOversampling;
-  std::recursive_mutex oversamplingMutex;
-  OversamplingAttachments<std::recursive_mutex> oversamplingAttachments;
+
+  struct OversamplingEngine
+  {
+    oversimple::OversamplingSettings settings;
+    // engines built before the last prepareToPlay are discarded
+    int generation;
+    Chain<double>::Oversamplers doubleOversamplers;
+    Chain<float>::Oversamplers floatOversamplers;
+    Chain<double, maxNumChannels>::Oversamplers multichannelDoubleOversamplers;
+    Chain<float, maxNumChannels>::Oversamplers multichannelFloatOversamplers;
+
+    OversamplingEngine(oversimple::OversamplingSettings const& settings,
+                       int generation,
+                       bool isMultichannel,
+                       bool isSideChainConnected)
+      : settings(settings)
+      , generation(generation)
+      , doubleOversamplers(settings, !isMultichannel, isSideChainConnected)
+      , floatOversamplers(settings, !isMultichannel, isSideChainConnected)
+      , multichannelDoubleOversamplers(settings,
+                                       isMultichannel,
+                                       isSideChainConnected)
+      , multichannelFloatOversamplers(settings,
+                                      isMultichannel,
+                                      isSideChainConnected)
+    {}
+
+    void swapInto(CurvessorAudioProcessor& processor)
+    {
+      processor.doubleChain.swapOversampling(doubleOversamplers);
+      processor.floatChain.swapOversampling(floatOversamplers);
+      processor.multichannelDoubleChain.swapOversampling(
+        multichannelDoubleOversamplers);
+      processor.multichannelFloatChain.swapOversampling(
+        multichannelFloatOversamplers);
+    }
+  };
+
+  class OversamplingBuilder final : public Thread
+  {
+  public:
+    explicit OversamplingBuilder(CurvessorAudioProcessor& processor)
+      : Thread("Curvessor Oversampling Builder")
+      , processor(processor)
+    {}
+
+    void run() override;
+
+  private:
+    CurvessorAudioProcessor& processor;
+  };
+
+  std::atomic<OversamplingEngine*> pendingOversampling{ nullptr };
+  std::atomic<OversamplingEngine*> retiredOversampling{ nullptr };
+  std::atomic<bool> isOversamplingChangeRequested{ false };
+  std::atomic<int> oversamplingGeneration{ 0 };
+  std::atomic<uint32_t> maxNumInputSamples{ 0 };
+  std::atomic<bool> isSideChainConnected{ false };
+  std::atomic<bool> isMultichannelLayout{ false };
+
+  OversamplingBuilder oversamplingBuilder{ *this };
+
+  enum class OversamplingFade
+  {
+    none,
+    out,
+    in
+  };
+
+  OversamplingFade oversamplingFade = OversamplingFade::none;
+
+  // duration of each of the fades around an oversampling swap
+  static constexpr double oversamplingFadeTime = 0.005;
+
+  // host samples the fade in still waits for, see applyOversamplingFade
+  int oversamplingFadeInDelay = 0;
+
+  // builds an engine from the current parameters, on any thread
+  std::unique_ptr<OversamplingEngine> makeOversamplingEngine() const;
+
+  // installs new oversamplers right away, only while not processing
+  void updateOversampling();
+
+  // called by the audio thread at the start and at the end of each block
+  void beginOversamplingSwap();
+  template<class FloatType>
+  void applyOversamplingFade(AudioBuffer<FloatType>& buffer);
+
+  void parameterChanged(const String& parameterID, float newValue) override;
+
+  // Latency reported to the host: the wet oversampling latency plus the
+  // lookahead, rounded to samples. The audio thread updates it each block, so
+  // it follows oversampling swaps, and a timer on the message thread tells
+  // the host. Polling, as posting a message from the audio thread may lock or
+  // allocate.
+  std::atomic<int> latencySamples{ 0 };
+
+  static constexpr int latencyPollingIntervalMs = 50;
+
+  void updateLatency(double latency);
+  void timerCallback() override;
 
 public:
   // for gui
@@ -97,6 +533,9 @@ public:
 
   Parameters& getCurvessorParameters() { return parameters; }
 
+  // the editor is the only consumer of the timings
+  curvessor::BlockProfiler& getProfiler() { return profiler; }
+
   std::array<std::atomic<float>, 2> levelVuMeterResults;
   std::array<std::atomic<float>, 2> gainVuMeterResults;
 
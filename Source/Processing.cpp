@@ -18,41 +18,23 @@ along with Curvessor.  If not, see <https://www.gnu.org/licenses/>.
 */
 
 #include "PluginProcessor.h"
+#include "BlockStages.h"
 
-static void
-leftRightToMidSide(double** io, int const n)
-{
-  for (int i = 0; i < n; ++i) {
-    double m = 0.5 * (io[0][i] + io[1][i]);
-    double s = 0.5 * (io[0][i] - io[1][i]);
-    io[0][i] = m;
-    io[1][i] = s;
-  }
-}
+// The channels of an interleaved oversampling buffer, as the SIMD type of
+// the chain: Vec2d or Vec4f for stereo, Vec8d or Vec8f for wider buses.
 
-static void
-midSideToLeftRight(double** io, int const n)
+template<class Vec, class InterleavedBuffer>
+static auto&
+getVecBuffer(InterleavedBuffer& buffer)
 {
-  for (int i = 0; i < n; ++i) {
-    double l = io[0][i] + io[1][i];
-    double r = io[0][i] - io[1][i];
-    io[0][i] = l;
-    io[1][i] = r;
+  if constexpr (Vec::size() == 8) {
+    return buffer.getBuffer8(0);
   }
-}
-
-static void
-applyGain(double** io,
-          double* gain_target,
-          double* gain_state,
-          double const alpha,
-          int const n)
-{
-  for (int c = 0; c < 2; ++c) {
-    for (int i = 0; i < n; ++i) {
-      gain_state[c] = gain_target[c] + alpha * (gain_state[c] - gain_target[c]);
-      io[c][i] *= gain_state[c];
-    }
+  else if constexpr (Vec::size() == 4) {
+    return buffer.getBuffer4(0);
+  }
+  else {
+    return buffer.getBuffer2(0);
   }
 }
 
@@ -67,97 +49,314 @@ void
 CurvessorAudioProcessor::processBlock(AudioBuffer<double>& buffer,
                                       MidiBuffer& midi)
 {
+  curvessor::ScopedAllocationCheck const allocationCheck;
+
+  beginOversamplingSwap();
+  if (isMultichannelLayout.load(std::memory_order_relaxed)) {
+    processInSlices(buffer, useChain(multichannelDoubleChain));
+  }
+  else {
+    processInSlices(buffer, useChain(doubleChain));
+  }
+  applyOversamplingFade(buffer);
+}
+
+template<class HostFloat, class FloatType, int maxChannels>
+void
+CurvessorAudioProcessor::process(AudioBuffer<HostFloat>& buffer,
+                                 Chain<FloatType, maxChannels>& chain)
+{
+  using ChainType = Chain<FloatType, maxChannels>;
+  using Vec = typename ChainType::Vec;
+  using curvessor::ProfilingStage;
+  constexpr int numLanes = ChainType::Dsp::numLanes;
+
   ScopedNoDenormals noDenormals;
 
+  profiler.start();
+
+  auto& dsp = chain.dsp;
+  auto& dryBuffer = chain.dryBuffer;
+  auto& wetOversampling = *chain.wetOversampling;
+  auto& dryOversampling = *chain.dryOversampling;
+
   auto const totalNumInputChannels = getTotalNumInputChannels();
   auto const totalNumOutputChannels = getTotalNumOutputChannels();
   auto const numSamples = buffer.getNumSamples();
 
-  double* ioAudio[2] = { buffer.getWritePointer(0), buffer.getWritePointer(1) };
+  int const numChannels = maxChannels == 2 ? 2 : numMainChannels;
+
+  if constexpr (!std::is_same_v<HostFloat, FloatType>) {
+    // never longer than the prepared block, so it does not reallocate
+    floatToDouble.setSize(
+      floatToDouble.getNumChannels(), numSamples, false, false, true);
+  }
+
+  // The host buffer is only read by the input stage and written by the
+  // output stage. In between, the chain works in place in it if it has the
+  // precision of the chain, otherwise in floatToDouble. The lanes past the
+  // channels of the bus are fed silence and never written.
+
+  auto const getChainChannel = [&](int const c) -> FloatType* {
+    if constexpr (std::is_same_v<HostFloat, FloatType>) {
+      return buffer.getWritePointer(c);
+    }
+    else {
+      return floatToDouble.getWritePointer(c);
+    }
+  };
+
+  HostFloat* hostAudio[maxChannels];
+  FloatType* ioAudio[maxChannels];
+  for (int c = 0; c < maxChannels; ++c) {
+    hostAudio[c] = c < numChannels ? buffer.getWritePointer(c) : nullptr;
+    ioAudio[c] = c < numChannels ? getChainChannel(c) : chain.silence.data();
+  }
 
   // update settings from parameters
 
-  bool const isMidSideEnabled = parameters.midSide->get();
+  bool const isMidSideEnabled = parameters.midSide->get() && numChannels == 2;
 
-  bool const isSideChainAvailable = totalNumInputChannels == 4;
+  bool const isSideChainAvailable =
+    totalNumInputChannels == 2 * numChannels && chain.sidechainOversampling;
 
   bool const isSideChainRequested = parameters.sideChain->get();
 
   bool const isUsingSideChain = isSideChainRequested && isSideChainAvailable;
 
-  dsp->stereoLinkTarget = 0.01 * parameters.stereoLink->get();
+  // gain link, see GainLink.h
 
-  double const invUpsampledSampleRate =
-    1.0 / (getSampleRate() * wetOversampling.getOversamplingRate());
+  auto const gainLinkMode =
+    static_cast<GainLinkMode>(parameters.gainLink->getIndex());
+  int const gainLinkChannel = parameters.gainLinkChannel->getIndex();
 
-  double const bltFrequencyCoef =
-    MathConstants<double>::pi * invUpsampledSampleRate;
+  updateGainLinkSender(gainLinkMode == GainLinkMode::send ? gainLinkChannel
+                                                          : -1);
+
+  // sends the gain the kernel wrote to chain.gainOutput, or 0 dB if it did
+  // not run; the even lanes go to the left channel, the odd ones to the right
+  auto const sendGain = [&](bool const isGainComputed) {
+    if (gainLinkSendChannel < 0) {
+      return;
+    }
+    float* sentGain[2] = { chain.linkedGain.data(),
+                           chain.linkedGain.data() + numSamples };
+    for (int i = 0; i < numSamples; ++i) {
+      for (int p = 0; p < 2; ++p) {
+        float gain = 0.f;
+        if (isGainComputed) {
+          Vec const frame = chain.gainOutput[i];
+          gain = static_cast<float>(frame[p]);
+          for (int c = p + 2; c < numChannels; c += 2) {
+            gain = std::min(gain, static_cast<float>(frame[c]));
+          }
+        }
+        sentGain[p][i] = gain;
+      }
+    }
+    curvessor::GainLink::getInstance().write(
+      gainLinkSendChannel, sentGain, numSamples);
+  };
+
+  double const stereoLink = 0.01 * parameters.stereoLink->get();
+
+  for (int c = 0; c < numLanes; ++c) {
+    dsp->stereoLinkTarget[c] = (stereoLinkLaneMask >> c) & 1 ? stereoLink : 0.0;
+  }
+
+  dsp->busLinkTarget = 0.01 * parameters.busLink->get();
+
+  // coefficients, recomputed only when their inputs change, see ControlCache
+
+  auto& controls = chain.controls;
+
+  int const oversamplingRate =
+    static_cast<int>(wetOversampling.getOversamplingRate());
+
+  double const upsampledSampleRate = getSampleRate() * oversamplingRate;
+
+  // the detector runs at a fraction of the oversampled rate, and so do the
+  // coefficients of the kernel
+  int const detectorDecimation = [&] {
+    switch (static_cast<DetectorRate>(parameters.detectorRate->getIndex())) {
+      case DetectorRate::twice:
+        return std::max(1, oversamplingRate / 2);
+      case DetectorRate::once:
+        return oversamplingRate;
+      case DetectorRate::full:
+      default:
+        return 1;
+    }
+  }();
+  dsp->detectorDecimation = detectorDecimation;
+  dsp->setGainBandLimit(parameters.bandLimitedGain->get(), oversamplingRate);
+
+  double const detectorSampleRate = upsampledSampleRate / detectorDecimation;
+
+  // multiband, see Chain::upperBands
+  int const numBands = std::clamp(
+    parameters.numBands->getIndex() + 1, 1, ChainType::maxNumBands);
+
+  bool const hasRateChanged =
+    upsampledSampleRate != controls.upsampledSampleRate ||
+    detectorSampleRate != controls.detectorSampleRate ||
+    numChannels != controls.numChannels;
+  controls.upsampledSampleRate = upsampledSampleRate;
+  controls.detectorSampleRate = detectorSampleRate;
+  controls.numChannels = numChannels;
+
+  double const invUpsampledSampleRate = 1.0 / upsampledSampleRate;
 
   double const upsampledAngularFrequencyCoef =
     1000.0 * MathConstants<double>::twoPi * invUpsampledSampleRate;
 
+  double const bltFrequencyCoef =
+    MathConstants<double>::pi / detectorSampleRate;
+
+  double const detectorAngularFrequencyCoef =
+    1000.0 * MathConstants<double>::twoPi / detectorSampleRate;
+
   float const smoothingTime = parameters.smoothingTime->get();
 
-  double const automationAlpha =
-    smoothingTime == 0.f ? 0.f
-                         : exp(-upsampledAngularFrequencyCoef / smoothingTime);
+  if (hasRateChanged || smoothingTime != controls.smoothingTime) {
+    controls.smoothingTime = smoothingTime;
+    controls.automationAlpha =
+      smoothingTime == 0.f
+        ? 0.0
+        : exp(-upsampledAngularFrequencyCoef / smoothingTime);
+    controls.detectorAutomationAlpha =
+      smoothingTime == 0.f
+        ? 0.0
+        : exp(-detectorAngularFrequencyCoef / smoothingTime);
+    dsp->setAutomationAlpha(controls.detectorAutomationAlpha);
+  }
+
+  double const automationAlpha = controls.automationAlpha;
+
+  bool isEnvelopeChanged[curvessor::maxNumBands][2];
+
+  for (int p = 0; p < 2; ++p) {
+    auto& cached = controls.channels[p];
+
+    float const inputGainDb = parameters.inputGain.get(p)->get();
+    if (inputGainDb != cached.inputGainDb) {
+      cached.inputGainDb = inputGainDb;
+      cached.inputGain = exp(db_to_lin * inputGainDb);
+    }
+
+    float const outputGainDb = parameters.outputGain.get(p)->get();
+    if (outputGainDb != cached.outputGainDb) {
+      cached.outputGainDb = outputGainDb;
+      cached.outputGain = exp(db_to_lin * outputGainDb);
+    }
+
+    float const highPassCutoff = parameters.highPassCutoff.get(p)->get();
+    if (hasRateChanged || highPassCutoff != cached.highPassCutoff) {
+      cached.highPassCutoff = highPassCutoff;
+      double const g = tan(bltFrequencyCoef * highPassCutoff);
+      cached.highPassCoef = g / (1.0 + g);
+    }
+
+    for (int band = 0; band < numBands; ++band) {
+      auto& envelopeFollower = parameters.getEnvelopeFollower(band);
+      auto& envelope = cached.envelopes[band];
+      float const rmsTime = envelopeFollower.rmsTime.get(p)->get();
+      float const attack = envelopeFollower.attack.get(p)->get();
+      float const release = envelopeFollower.release.get(p)->get();
+      float const attackDelay = envelopeFollower.attackDelay.get(p)->get();
+      float const releaseDelay = envelopeFollower.releaseDelay.get(p)->get();
+
+      isEnvelopeChanged[band][p] =
+        hasRateChanged || rmsTime != envelope.rmsTime ||
+        attack != envelope.attack || release != envelope.release ||
+        attackDelay != envelope.attackDelay ||
+        releaseDelay != envelope.releaseDelay;
+
+      envelope.rmsTime = rmsTime;
+      envelope.attack = attack;
+      envelope.release = release;
+      envelope.attackDelay = attackDelay;
+      envelope.releaseDelay = releaseDelay;
+    }
+
+    // the bands out of use are set up again when they come back
+    for (int band = numBands; band < curvessor::maxNumBands; ++band) {
+      cached.envelopes[band] = {};
+    }
+  }
 
-  double const upsampledAutomationAlpha =
-    smoothingTime == 0.f ? 0.f
-                         : exp(-upsampledAngularFrequencyCoef / smoothingTime);
+  alignas(sizeof(Vec)) FloatType inputGainTarget[numLanes] = {};
+  alignas(sizeof(Vec)) FloatType outputGainTarget[numLanes] = {};
+  alignas(sizeof(Vec)) FloatType wetAmountTarget[numLanes] = {};
 
-  dsp->automationAlpha = upsampledAutomationAlpha;
+  // the parameters of the left channel drive the even lanes, the ones of the
+  // right channel the odd lanes
 
-  double inputGainTarget[2];
-  double outputGainTarget[2];
-  double wetAmountTarget[2];
+  for (int c = 0; c < numChannels; ++c) {
 
-  for (int c = 0; c < 2; ++c) {
+    int const p = c % 2;
+    auto const& cached = controls.channels[p];
 
-    outputGainTarget[c] = exp(db_to_lin * parameters.outputGain.get(c)->get());
-    inputGainTarget[c] = exp(db_to_lin * parameters.inputGain.get(c)->get());
+    outputGainTarget[c] = cached.outputGain;
+    inputGainTarget[c] = cached.inputGain;
 
-    wetAmountTarget[c] = 0.01 * parameters.wet.get(c)->get();
+    wetAmountTarget[c] = 0.01 * parameters.wet.get(p)->get();
     dsp->feedbackAmountTarget[c] =
-      0.01 * parameters.feedbackAmount.get(c)->get();
+      0.01 * parameters.feedbackAmount.get(p)->get();
+
+    dsp->highPassCoef[c] = cached.highPassCoef;
 
-    dsp->highPassCoef[c] = [&] {
-      double const g =
-        tan(bltFrequencyCoef * parameters.highPassCutoff.get(c)->get());
-      return g / (1.0 + g);
-    }();
+    for (int band = 0; band < numBands; ++band) {
+      if (!isEnvelopeChanged[band][p]) {
+        continue;
+      }
 
-    // evenlope follower settings
+      // envelope follower settings
 
-    float const rmsTime = parameters.envelopeFollower.rmsTime.get(c)->get();
+      auto const& envelope = cached.envelopes[band];
 
-    bool const rmsAlpha =
-      rmsTime == 0.f ? 0.f : exp(-upsampledAngularFrequencyCoef / rmsTime);
+      bool const rmsAlpha =
+        envelope.rmsTime == 0.f
+          ? 0.f
+          : exp(-detectorAngularFrequencyCoef / envelope.rmsTime);
 
-    double const attackFrequency =
-      parameters.envelopeFollower.attack.get(c)->get();
+      double const attackFrequency = envelope.attack;
 
-    double const releaseFrequency =
-      upsampledAngularFrequencyCoef /
-      parameters.envelopeFollower.release.get(c)->get();
+      double const releaseFrequency =
+        detectorAngularFrequencyCoef / envelope.release;
 
-    double const attackDelay =
-      0.01 * parameters.envelopeFollower.attackDelay.get(c)->get();
+      double const attackDelay = 0.01 * envelope.attackDelay;
 
-    double const releaseDelay =
-      0.01 * parameters.envelopeFollower.releaseDelay.get(c)->get();
+      double const releaseDelay = 0.01 * envelope.releaseDelay;
 
-    envelopeFollowerSettings.setup(c,
-                                   rmsAlpha,
-                                   attackFrequency,
-                                   releaseFrequency,
-                                   attackDelay,
-                                   releaseDelay);
+      chain.getEnvelopeFollowerSettings(band).setup(c,
+                                                    rmsAlpha,
+                                                    attackFrequency,
+                                                    releaseFrequency,
+                                                    attackDelay,
+                                                    releaseDelay);
+    }
   }
 
-  dsp->autoSpline.automator.setSmoothingAlpha(upsampledAutomationAlpha);
+  // the curve of each band, a band with no active knot is only delayed by
+  // the lookahead
+
+  int numActiveKnots[curvessor::maxNumBands] = {};
+  int maxNumActiveKnots = 0;
 
-  int numActiveKnots = parameters.spline->updateSpline(dsp->autoSpline);
+  for (int band = 0; band < numBands; ++band) {
+    auto& bandDsp = chain.getDsp(band);
+
+    bandDsp.autoSpline.automator.setSmoothingAlpha(
+      controls.detectorAutomationAlpha);
+
+    numActiveKnots[band] =
+      parameters.getSpline(band).updateSpline(bandDsp.autoSpline);
+
+    maxNumActiveKnots = std::max(maxNumActiveKnots, numActiveKnots[band]);
+
+    bandDsp.updateGainTable(numActiveKnots[band]);
+  }
 
   bool const isWetPassNeeded = [&] {
     double m = wetAmountTarget[0] * wetAmountTarget[1] * dsp->wetAmount[0] *
@@ -173,43 +372,225 @@ CurvessorAudioProcessor::processBlock(AudioBuffer<double>& buffer,
   }();
 
   bool const isBypassing =
-    (!isWetPassNeeded && (dsp->wetAmount[0] == 0.0)) || (numActiveKnots == 0);
+    (!isWetPassNeeded && (dsp->wetAmount[0] == 0.0)) ||
+    (maxNumActiveKnots == 0);
 
   int const highPassOrder = parameters.highPassOrder->getIndex();
 
-  // ready to process
+  // The dry signal is aligned with the wet one either by a plain delay, exact
+  // for linear phase oversampling, or by running it through a second
+  // oversampler, which also matches the phase response of the minimum phase
+  // filters. The delay is fed on every block so that it can take over at any
+  // time. With lookahead only the delay can match the wet signal.
+
+  double const wetLatency = wetOversampling.getLatency();
+
+  int const lookaheadSamples = [&] {
+    int const requested = getLookaheadSamples();
+    return chain.dryDelay.canProcess(wetLatency + requested, numSamples)
+             ? requested
+             : 0;
+  }();
+
+  double const latency = wetLatency + lookaheadSamples;
+
+  updateLatency(latency);
+
+  // The gain frames sent are those of the upsampled audio they are applied
+  // to, which lags the input by the upsampling latency, half of the round
+  // trip as the up and down sampling filters are the same, and by the
+  // lookahead.
+  if (gainLinkSendChannel >= 0) {
+    curvessor::GainLink::getInstance().setLatency(
+      gainLinkSendChannel, 0.5 * wetLatency + lookaheadSamples);
+  }
+
+  bool const canDelayDryPath = chain.dryDelay.canProcess(latency, numSamples);
+
+  bool const isDryPathDelayed = canDelayDryPath && [&] {
+    if (lookaheadSamples > 0) {
+      return true;
+    }
+    switch (static_cast<DryPath>(parameters.dryPath->getIndex())) {
+      case DryPath::delay:
+        return true;
+      case DryPath::phaseCompensated:
+        return false;
+      case DryPath::automatic:
+      default:
+        return oversamplingSettings.isUsingLinearPhase ||
+               wetOversampling.getOversamplingRate() == 1;
+    }
+  }();
+
+  if (chain.wasDryPathDelayed && !isDryPathDelayed) {
+    dryOversampling.reset();
+  }
+  chain.wasDryPathDelayed = isDryPathDelayed;
+
+  // Idle mode: when bypassing and the dry delay can stand in for the whole
+  // chain, nothing but the delay runs. Waking up, the oversamplers are reset
+  // and given their latency to fill up before the output fades back to them.
+
+  bool const canIdle = isBypassing && canDelayDryPath;
+
+  // Receiving on the gain link, the gain read from the link is applied to the
+  // delayed dry signal and the chain is not run, as when idle.
+
+  bool const isReceivingGain =
+    gainLinkMode == GainLinkMode::receive && canDelayDryPath;
+
+  if ((chain.isIdle && !canIdle) ||
+      (chain.wasReceivingGain && !isReceivingGain)) {
+    wetOversampling.reset();
+    dryOversampling.reset();
+    if (chain.sidechainOversampling) {
+      chain.sidechainOversampling->reset();
+    }
+    chain.wasUsingSideChain = false;
+    chain.idleWarmUpSamples = static_cast<int>(std::ceil(latency));
+    // the delayed dry signal covers the warm up
+    chain.idleFade = 1.0;
+    chain.isIdle = false;
+  }
+
+  chain.wasReceivingGain = isReceivingGain;
 
-  // mid side
+  // New oversamplers, see beginOversamplingSwap, are already reset and are
+  // warmed up the same way. Without the delayed dry signal, the output is
+  // held silent while they fill up instead.
 
-  if (isMidSideEnabled) {
-    leftRightToMidSide(ioAudio, numSamples);
+  if (chain.isOversamplingSwapped) {
+    chain.isOversamplingSwapped = false;
+    if (canDelayDryPath) {
+      chain.idleWarmUpSamples = static_cast<int>(std::ceil(latency));
+      chain.idleFade = 1.0;
+    }
+    else {
+      oversamplingFadeInDelay = static_cast<int>(std::ceil(latency));
+    }
   }
 
-  // copy the dry signal
+  // ready to process
+
+  profiler.mark(ProfilingStage::setup);
+
+  // conversion to the precision of the chain, mid side encoding, the copy of
+  // the dry signal and the input gain, in a single pass; the gain is left
+  // alone when the chain does not run
+
+  bool const isChainRunning = !chain.isIdle && !isReceivingGain;
 
   dryBuffer.setNumSamples(numSamples);
 
-  for (int c = 0; c < 2; ++c) {
-    std::copy(ioAudio[c], ioAudio[c] + numSamples, dryBuffer.get()[c]);
+  curvessor::prepareInput(hostAudio,
+                          ioAudio,
+                          dryBuffer.get(),
+                          numChannels,
+                          numSamples,
+                          isMidSideEnabled,
+                          isChainRunning,
+                          inputGainTarget,
+                          dsp->inputGain,
+                          static_cast<FloatType>(automationAlpha));
+
+  for (int c = numChannels; c < maxChannels; ++c) {
+    std::fill_n(dryBuffer.get()[c], numSamples, FloatType(0));
   }
 
-  // input gain
+  Vec const* delayedDry =
+    canDelayDryPath ? chain.dryDelay.process(
+                        dryBuffer.get(), numChannels, numSamples, latency)
+                    : nullptr;
+
+  profiler.mark(ProfilingStage::inputGain);
+
+  if (isReceivingGain) {
+    float* linkedGain[2] = { chain.linkedGain.data(),
+                             chain.linkedGain.data() + numSamples };
 
-  applyGain(
-    ioAudio, inputGainTarget, dsp->inputGain, automationAlpha, numSamples);
+    // the dry signal lags the input by latency, the gain frames of the
+    // sender lag its input by their own latency
+    auto& gainLink = curvessor::GainLink::getInstance();
+    int const gainLinkDelay = std::max(
+      0,
+      static_cast<int>(
+        std::lround(latency - gainLink.getLatency(gainLinkChannel))));
+
+    gainLink.read(gainLinkChannel,
+                  gainLinkReader,
+                  linkedGain,
+                  sliceOffset,
+                  numSamples,
+                  hostBlockSize,
+                  gainLinkDelay);
+
+    Vec alpha = static_cast<FloatType>(automationAlpha);
+
+    Vec inputGain = Vec().load(dsp->inputGain);
+    Vec inputGainTargetVec = Vec().load_a(inputGainTarget);
+    Vec outputGain = Vec().load(dsp->outputGain);
+    Vec outputGainTargetVec = Vec().load_a(outputGainTarget);
+    Vec amount = Vec().load(dsp->wetAmount);
+    Vec amountTarget = Vec().load_a(wetAmountTarget);
+
+    alignas(sizeof(Vec)) FloatType gainFrame[numLanes] = {};
+
+    for (int i = 0; i < numSamples; ++i) {
+      FloatType const gain[2] = {
+        static_cast<FloatType>(exp(db_to_lin * linkedGain[0][i])),
+        static_cast<FloatType>(exp(db_to_lin * linkedGain[1][i]))
+      };
+      for (int c = 0; c < numChannels; ++c) {
+        gainFrame[c] = gain[c & 1];
+      }
+      inputGain =
+        inputGainTargetVec + alpha * (inputGain - inputGainTargetVec);
+      outputGain =
+        outputGainTargetVec + alpha * (outputGain - outputGainTargetVec);
+      amount = amountTarget + alpha * (amount - amountTarget);
+      Vec const dry = delayedDry[i];
+      Vec const wet = outputGain * Vec().load_a(gainFrame) * inputGain * dry;
+      Vec const out = amount * (wet - dry) + dry;
+      curvessor::storeFrame(
+        out, hostAudio, i, numChannels, isMidSideEnabled);
+    }
+
+    inputGain.store(dsp->inputGain);
+    outputGain.store(dsp->outputGain);
+    amount.store(dsp->wetAmount);
+
+    for (int i = 0; i < 2; ++i) {
+      gainVuMeterResults[i].store(gainLinkReader.lastGainDb[i]);
+    }
+    profiler.mark(ProfilingStage::mix);
+    profiler.finish(numSamples);
+    return;
+  }
+
+  if (chain.isIdle) {
+    sendGain(false);
+    for (int i = 0; i < numSamples; ++i) {
+      curvessor::storeFrame(
+        delayedDry[i], hostAudio, i, numChannels, isMidSideEnabled);
+    }
+    profiler.mark(ProfilingStage::mix);
+    profiler.finish(numSamples);
+    return;
+  }
 
   // oversampling
 
   auto const numInputSamples = static_cast<uint32_t>(numSamples);
 
   wetOversampling.prepareBuffers(numInputSamples);
-  dryOversampling.prepareBuffers(numInputSamples);
-  sidechainOversampling.prepareBuffers(numInputSamples);
-
   uint32_t const numUpsampledSamples =
     wetOversampling.upSample(ioAudio, numInputSamples);
 
-  dryOversampling.upSample(dryBuffer.get(), numInputSamples);
+  if (!isDryPathDelayed) {
+    dryOversampling.prepareBuffers(numInputSamples);
+    dryOversampling.upSample(dryBuffer.get(), numInputSamples);
+  }
 
   if (numUpsampledSamples == 0) {
     for (auto i = 0; i < totalNumOutputChannels; ++i) {
@@ -219,36 +600,75 @@ CurvessorAudioProcessor::processBlock(AudioBuffer<double>& buffer,
   }
 
   auto& upsampledBuffer = wetOversampling.getUpSampleOutputInterleaved();
-  auto& upsampledIo = upsampledBuffer.getBuffer2(0);
-  auto& upsampledDryBuffer = dryOversampling.getUpSampleOutputInterleaved();
+  auto& upsampledIo = getVecBuffer<Vec>(upsampledBuffer);
 
   // sidechain
 
-  double* envelopeInput[2] = { buffer.getWritePointer(isUsingSideChain ? 2 : 0),
-                               buffer.getWritePointer(isUsingSideChain ? 3
-                                                                       : 1) };
-
   if (isUsingSideChain) {
-    if (isMidSideEnabled) {
-      leftRightToMidSide(envelopeInput, numSamples);
+    auto& sidechainOversampling = *chain.sidechainOversampling;
+
+    if (!chain.wasUsingSideChain) {
+      // the filters hold whatever the sidechain carried when it was last used
+      sidechainOversampling.reset();
+      chain.sidechainCrossover.reset();
+      chain.sideChainFade = 0.0;
+    }
+
+    HostFloat const* hostSideChain[maxChannels];
+    FloatType* envelopeInput[maxChannels];
+    for (int c = 0; c < maxChannels; ++c) {
+      bool const isUsed = c < numChannels;
+      hostSideChain[c] =
+        isUsed ? buffer.getReadPointer(numChannels + c) : nullptr;
+      envelopeInput[c] =
+        isUsed ? getChainChannel(numChannels + c) : chain.silence.data();
     }
 
-    applyGain(envelopeInput,
-              inputGainTarget,
-              dsp->sidechainInputGain,
-              automationAlpha,
-              numSamples);
+    curvessor::prepareInput(hostSideChain,
+                            envelopeInput,
+                            static_cast<FloatType* const*>(nullptr),
+                            numChannels,
+                            numSamples,
+                            isMidSideEnabled,
+                            true,
+                            inputGainTarget,
+                            dsp->sidechainInputGain,
+                            static_cast<FloatType>(automationAlpha));
+
+    sidechainOversampling.prepareBuffers(numInputSamples);
+    sidechainOversampling.upSample(envelopeInput, numInputSamples);
+
+    // cross-fade the detector input from the main signal, which fed the
+    // detector until now, to the sidechain
+
+    if (chain.sideChainFade < 1.0) {
+      auto& upsampledSideChainInput = getVecBuffer<Vec>(
+        sidechainOversampling.getUpSampleOutputInterleaved());
+
+      double const fadeStep = invUpsampledSampleRate / sideChainFadeTime;
+      int const numUpsampled = static_cast<int>(numUpsampledSamples);
+      double fade = chain.sideChainFade;
+
+      for (int i = 0; i < numUpsampled; ++i) {
+        fade = std::min(1.0, fade + fadeStep);
+        Vec const main = upsampledIo[i];
+        upsampledSideChainInput[i] =
+          main + static_cast<FloatType>(fade) *
+                   (upsampledSideChainInput[i] - main);
+      }
+
+      chain.sideChainFade = fade;
+    }
   }
 
-  sidechainOversampling.upSample(envelopeInput, numInputSamples);
+  chain.wasUsingSideChain = isUsingSideChain;
 
-  auto& upsampledSideChainInput =
-    sidechainOversampling.getUpSampleOutputInterleaved().getBuffer2(0);
+  profiler.mark(ProfilingStage::upSampling);
 
   // processing
 
   const bool isFeedbackNeeded = [&] {
-    for (int c = 0; c < 2; ++c) {
+    for (int c = 0; c < numChannels; ++c) {
       if (dsp->feedbackAmountTarget[c] > 0.f) {
         return true;
       }
@@ -259,90 +679,214 @@ CurvessorAudioProcessor::processBlock(AudioBuffer<double>& buffer,
     return false;
   }();
 
-  if (!isBypassing) {
+  // the kernel writes one gain frame per input sample when sending
+  int gainOutputLog2Stride = 0;
+  while ((numInputSamples << gainOutputLog2Stride) < numUpsampledSamples) {
+    ++gainOutputLog2Stride;
+  }
+  bool const canSendGain =
+    gainLinkSendChannel >= 0 && numBands == 1 &&
+    (numInputSamples << gainOutputLog2Stride) == numUpsampledSamples;
+  dsp->gainOutput = canSendGain ? chain.gainOutput.data() : nullptr;
+  dsp->gainOutputLog2Stride = gainOutputLog2Stride;
+
+  dsp->lookaheadDelay =
+    std::min(lookaheadSamples << gainOutputLog2Stride, dsp->lookaheadMask);
+
+  // the kernel of a band, in place in its io buffer
+  auto const processBand = [&](auto& bandDsp,
+                               auto& io,
+                               auto& sidechain,
+                               int const numKnots) {
     if (isSideChainRequested) {
-      if (isSideChainAvailable) {
-        dsp->sidechainProcess(
-          upsampledIo, upsampledSideChainInput, numActiveKnots, highPassOrder);
-      }
+      bandDsp.sidechainProcess(io, sidechain, numKnots, highPassOrder);
     }
     else if (isFeedbackNeeded) {
-      dsp->feedbackProcess(upsampledIo, numActiveKnots, highPassOrder);
+      bandDsp.feedbackProcess(io, numKnots, highPassOrder);
     }
     else {
-      dsp->forwardProcess(upsampledIo, numActiveKnots, highPassOrder);
+      bandDsp.forwardProcess(io, numKnots, highPassOrder);
+    }
+  };
+
+  int const numCrossoverSamples = static_cast<int>(numUpsampledSamples);
+  double crossoverFrequencies[curvessor::maxNumBands - 1];
+  for (int i = 0; i < curvessor::maxNumBands - 1; ++i) {
+    crossoverFrequencies[i] = parameters.crossover[i]->get();
+  }
+
+  // the band count is only changed with the splits reset
+  if (numBands != chain.crossover.getNumBands()) {
+    chain.crossover.reset();
+    chain.sidechainCrossover.reset();
+  }
+  chain.crossover.setup(crossoverFrequencies, numBands, upsampledSampleRate);
+  chain.sidechainCrossover.setup(
+    crossoverFrequencies, numBands, upsampledSampleRate);
+
+  bool const isGainComputed =
+    !isBypassing && (!isSideChainRequested || isSideChainAvailable);
+
+  if (isGainComputed) {
+    auto& upsampledSideChainInput =
+      isSideChainRequested
+        ? getVecBuffer<Vec>(
+            chain.sidechainOversampling->getUpSampleOutputInterleaved())
+        : upsampledIo;
+
+    using Buffer = std::remove_reference_t<decltype(upsampledIo)>;
+    Buffer* upperIo[curvessor::maxNumBands - 1] = {};
+    Buffer* upperSideChain[curvessor::maxNumBands - 1] = {};
+
+    for (int band = 1; band < numBands; ++band) {
+      auto& upperBand = chain.upperBands[band - 1];
+      upperBand.io.setNumSamples(numCrossoverSamples);
+      upperBand.sidechain.setNumSamples(numCrossoverSamples);
+      upperIo[band - 1] = &upperBand.io;
+      upperSideChain[band - 1] = &upperBand.sidechain;
+      upperBand.dsp->copySharedSettings(*dsp);
+    }
+
+    if (numBands > 1) {
+      chain.crossover.split(upsampledIo, upperIo, numCrossoverSamples);
+      if (isSideChainRequested) {
+        chain.sidechainCrossover.split(
+          upsampledSideChainInput, upperSideChain, numCrossoverSamples);
+      }
+    }
+
+    processBand(*dsp, upsampledIo, upsampledSideChainInput, numActiveKnots[0]);
+
+    for (int band = 1; band < numBands; ++band) {
+      auto& upperBand = chain.upperBands[band - 1];
+      processBand(*upperBand.dsp,
+                  upperBand.io,
+                  isSideChainRequested ? upperBand.sidechain : upperBand.io,
+                  numActiveKnots[band]);
+    }
+
+    if (numBands > 1) {
+      chain.crossover.sum(upsampledIo, upperIo, numCrossoverSamples);
     }
   }
 
+  sendGain(isGainComputed && canSendGain);
+
+  profiler.mark(ProfilingStage::kernel);
+
   // downsampling
 
   wetOversampling.downSample(upsampledBuffer, numInputSamples);
-  dryOversampling.downSample(upsampledDryBuffer, numInputSamples);
 
-  // dry-wet and output gain
+  if (!isDryPathDelayed) {
+    dryOversampling.downSample(dryOversampling.getUpSampleOutputInterleaved(),
+                               numInputSamples);
+  }
 
-  auto& wetOutput = wetOversampling.getDownSampleOutputInterleaved();
-  auto& dryOutput = dryOversampling.getDownSampleOutputInterleaved();
+  profiler.mark(ProfilingStage::downSampling);
 
-  if (isWetPassNeeded) {
+  // dry-wet, output gain, the idle cross-fade, mid side decoding and the
+  // deinterleaving to the host buffer, in a single pass
 
-    auto& dryBuffer = dryOutput.getBuffer2(0);
-    auto& wetBuffer = wetOutput.getBuffer2(0);
+  auto output = curvessor::OutputStage<Vec>{};
 
-    Vec2d alpha = automationAlpha;
+  output.wet =
+    isBypassing
+      ? nullptr
+      : &getVecBuffer<Vec>(wetOversampling.getDownSampleOutputInterleaved())[0];
 
-    Vec2d amount = Vec2d().load_a(dsp->wetAmount);
-    Vec2d amountTarget = Vec2d().load(wetAmountTarget);
+  output.dry = isDryPathDelayed
+                 ? delayedDry
+                 : &getVecBuffer<Vec>(
+                     dryOversampling.getDownSampleOutputInterleaved())[0];
 
-    Vec2d gain = Vec2d().load_a(dsp->outputGain);
-    Vec2d gainTarget = Vec2d().load(outputGainTarget);
+  output.isMixing = isWetPassNeeded;
+  output.wetAmount = dsp->wetAmount;
+  output.wetAmountTarget = wetAmountTarget;
+  output.outputGain = dsp->outputGain;
+  output.outputGainTarget = outputGainTarget;
+  output.alpha = static_cast<FloatType>(automationAlpha);
 
-    for (int i = 0; i < numSamples; ++i) {
-      amount = alpha * (amountTarget - amount) + amountTarget;
-      gain = alpha * (gainTarget - gain) + gainTarget;
-      Vec2d wet = gain * wetBuffer[i];
-      Vec2d dry = dryBuffer[i];
-      wetBuffer[i] = amount * (wet - dry) + dry;
-    }
+  // cross-fade between the chain and the delayed dry signal when going idle
+  // or waking up
 
-    amount.store(dsp->wetAmount);
-    gain.store(dsp->outputGain);
+  output.delayedDry = delayedDry;
+  output.fade = chain.idleFade;
+  output.fadeTarget = canIdle ? 1.0 : 0.0;
+  output.fadeStep = 1.0 / (idleFadeTime * getSampleRate());
+  output.warmUp = chain.idleWarmUpSamples;
+
+  output.isMidSide = isMidSideEnabled;
+  output.numChannels = numChannels;
+
+  output.process(hostAudio, numSamples);
+
+  if (delayedDry) {
+    chain.idleFade = output.fade;
+    chain.idleWarmUpSamples = output.warmUp;
+    chain.isIdle = canIdle && chain.idleFade == 1.0;
   }
   else {
-    if (!isBypassing) {
+    chain.idleFade = 0.0;
+    chain.idleWarmUpSamples = 0;
+  }
 
-      auto& wetBuffer = wetOutput.getBuffer2(0);
+  profiler.mark(ProfilingStage::mix);
 
-      Vec2d alpha = automationAlpha;
-      Vec2d gain = Vec2d().load(dsp->outputGain);
-      Vec2d gainTarget = Vec2d().load(outputGainTarget);
+  // update vu meters, each side showing the loudest level and the deepest
+  // gain reduction among the lanes it drives, and among the bands
 
-      for (int i = 0; i < numSamples; ++i) {
-        gain = alpha * (gainTarget - gain) + gainTarget;
-        wetBuffer[i] = gain * wetBuffer[i];
+  for (int i = 0; i < 2; ++i) {
+    auto level = dsp->levelVuMeterBuffer[i];
+    auto gain = dsp->gainVuMeterBuffer[i];
+    for (int band = 0; band < numBands; ++band) {
+      auto const& bandDsp = chain.getDsp(band);
+      for (int c = i; c < numChannels; c += 2) {
+        level = std::max(level, bandDsp.levelVuMeterBuffer[c]);
+        gain = std::min(gain, bandDsp.gainVuMeterBuffer[c]);
       }
-
-      gain.store(dsp->outputGain);
     }
+    levelVuMeterResults[i].store((float)level);
+    gainVuMeterResults[i].store((float)gain);
   }
 
-  if (isBypassing) {
-    dryOutput.deinterleave(ioAudio, 2, numSamples);
+  profiler.mark(ProfilingStage::meters);
+  profiler.finish(numSamples);
+}
+
+template<class HostFloat, class FloatType, int maxChannels>
+void
+CurvessorAudioProcessor::processInSlices(AudioBuffer<HostFloat>& buffer,
+                                         Chain<FloatType, maxChannels>& chain)
+{
+  int const numSamples = buffer.getNumSamples();
+  hostBlockSize = numSamples;
+  sliceOffset = 0;
+  if (numSamples <= preparedBlockSize || preparedBlockSize <= 0) {
+    process(buffer, chain);
+    return;
   }
-  else {
-    wetOutput.deinterleave(ioAudio, 2, numSamples);
+  // referring to at most 32 channels does not allocate
+  for (int start = 0; start < numSamples; start += preparedBlockSize) {
+    sliceOffset = start;
+    AudioBuffer<HostFloat> slice(buffer.getArrayOfWritePointers(),
+                                 buffer.getNumChannels(),
+                                 start,
+                                 jmin(preparedBlockSize, numSamples - start));
+    process(slice, chain);
   }
+}
 
-  // mid side
+template void
+CurvessorAudioProcessor::processInSlices(AudioBuffer<float>&, Chain<float>&);
 
-  if (isMidSideEnabled) {
-    midSideToLeftRight(ioAudio, numSamples);
-  }
+template void
+CurvessorAudioProcessor::processInSlices(AudioBuffer<float>&,
+                                         Chain<float, maxNumChannels>&);
 
-  // update vu meters
+template void
+CurvessorAudioProcessor::processInSlices(AudioBuffer<float>&, Chain<double>&);
 
-  for (int i = 0; i < 2; ++i) {
-    levelVuMeterResults[i].store((float)dsp->levelVuMeterBuffer[i]);
-    gainVuMeterResults[i].store((float)dsp->gainVuMeterBuffer[i]);
-  }
-}
+template void
+CurvessorAudioProcessor::processInSlices(AudioBuffer<float>&,
+                                         Chain<double, maxNumChannels>&);
@@ -0,0 +1,160 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Curvessor.
+
+Curvessor is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Curvessor is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Curvessor.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// Per-block timings of the stages of the processing, enabled with the
+// CURVESSOR_PROFILING CMake option. The audio thread stamps the end of each
+// stage with mark(), and pushes the timings of the block into a single
+// producer single consumer ring at finish(), dropping them if the ring is
+// full. The editor pops them. When profiling is disabled, BlockProfiler is
+// empty and its methods compile to nothing.
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#ifndef CURVESSOR_PROFILING
+#define CURVESSOR_PROFILING 0
+#endif
+
+namespace curvessor {
+
+enum class ProfilingStage
+{
+  // parameters and everything else before the input stage
+  setup,
+  // conversion, mid side encoding, dry copy and input gain, and the dry delay
+  inputGain,
+  // wet, dry and sidechain oversamplers
+  upSampling,
+  kernel,
+  downSampling,
+  // dry-wet, output gain, mid side decoding and deinterleaving
+  mix,
+  meters,
+  numStages
+};
+
+inline constexpr int numProfilingStages =
+  static_cast<int>(ProfilingStage::numStages);
+
+inline constexpr char const* profilingStageNames[numProfilingStages] = {
+  "setup", "input gain", "up", "kernel", "down", "mix", "meters"
+};
+
+struct BlockTimings
+{
+  std::array<uint32_t, numProfilingStages> ns{};
+  int numSamples = 0;
+};
+
+template<class T, int capacity>
+class SpscRing final
+{
+  static_assert((capacity & (capacity - 1)) == 0, "capacity is a power of 2");
+  static constexpr int mask = capacity - 1;
+
+public:
+  bool push(T const& item)
+  {
+    int const write = writeIndex.load(std::memory_order_relaxed);
+    int const next = (write + 1) & mask;
+    if (next == readIndex.load(std::memory_order_acquire)) {
+      return false;
+    }
+    items[write] = item;
+    writeIndex.store(next, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(T& item)
+  {
+    int const read = readIndex.load(std::memory_order_relaxed);
+    if (read == writeIndex.load(std::memory_order_acquire)) {
+      return false;
+    }
+    item = items[read];
+    readIndex.store((read + 1) & mask, std::memory_order_release);
+    return true;
+  }
+
+private:
+  std::array<T, capacity> items;
+  alignas(64) std::atomic<int> writeIndex{ 0 };
+  alignas(64) std::atomic<int> readIndex{ 0 };
+};
+
+#if CURVESSOR_PROFILING
+
+class BlockProfiler final
+{
+  using Clock = std::chrono::steady_clock;
+
+public:
+  static constexpr bool isEnabled = true;
+
+  void start()
+  {
+    timings = {};
+    last = Clock::now();
+  }
+
+  void mark(ProfilingStage const stage)
+  {
+    auto const now = Clock::now();
+    timings.ns[static_cast<int>(stage)] += static_cast<uint32_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(now - last)
+        .count());
+    last = now;
+  }
+
+  void finish(int const numSamples)
+  {
+    timings.numSamples = numSamples;
+    ring.push(timings);
+  }
+
+  // consumer side, a single thread at a time
+  bool pop(BlockTimings& blockTimings) { return ring.pop(blockTimings); }
+
+private:
+  BlockTimings timings;
+  Clock::time_point last;
+  // a few seconds of blocks at common block sizes
+  SpscRing<BlockTimings, 2048> ring;
+};
+
+#else
+
+class BlockProfiler final
+{
+public:
+  static constexpr bool isEnabled = false;
+
+  void start() {}
+  void mark(ProfilingStage) {}
+  void finish(int) {}
+  bool pop(BlockTimings&) { return false; }
+};
+
+#endif
+
+} // namespace curvessor
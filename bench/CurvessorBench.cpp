@@ -0,0 +1,1450 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Curvessor.
+
+Curvessor is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Curvessor is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Curvessor.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Offline benchmark of the Curvessor DSP core. Renders noise block by block
+// through the same path as Processing.cpp: dry path, wet and sidechain
+// oversampling, the kernels of CurvessorDsp.cpp and the output stage. JUCE is
+// not involved. Each case is timed per block, and the results are printed as
+// one JSON document.
+//
+// By default every axis is swept on its own around a baseline case; --full
+// runs the whole cartesian product instead.
+//
+// --latency checks the latency the plugin reports to the host instead: for
+// each oversampling setting it measures the delay of the wet oversampling
+// path and compares it with the rounded getLatency(), exiting with 1 if any
+// of them is more than maxLatencyError samples off.
+//
+// --aliasing measures instead the aliasing of the gain stage, as the power
+// outside the harmonics of a compressed sine, for full rate oversampling and
+// for the split rate and band-limited gain engines, see measureAliasing. It
+// exits with 1 if the band-limited gain at 2x or 4x rejects the aliasing
+// more than maxAliasingShortfallDb worse than full rate at 4x or 8x.
+//
+// --precision compares instead the single precision chain with the double
+// precision one on the same input, see measurePrecision.
+//
+// --gain-accuracy checks instead the error of the approximated dB to linear
+// tiers of GainMath.h against exp, exiting with 1 if a tier exceeds its
+// bound, see checkGainAccuracy.
+//
+// --fusion times instead the stages around the oversamplers, fused and as
+// the separate passes they replaced, see measureFusion.
+//
+// usage: curvessor_bench [--full | --latency | --aliasing | --precision |
+//                         --gain-accuracy | --fusion] [--seconds S]
+//                        [--sample-rate R] [--output file.json]
+
+#include "CurvessorDsp.h"
+#include "Crossover.h"
+#include "GainMath.h"
+#include "BlockStages.h"
+#include "DryDelay.h"
+#include "oversimple/Oversampling.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <numbers>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace {
+
+enum class Topology
+{
+  forward,
+  feedback,
+  sidechain
+};
+
+char const*
+toString(Topology const topology)
+{
+  switch (topology) {
+    case Topology::feedback:
+      return "feedback";
+    case Topology::sidechain:
+      return "sidechain";
+    case Topology::forward:
+    default:
+      return "forward";
+  }
+}
+
+char const*
+toDetectorRateString(int const detectorRate)
+{
+  switch (detectorRate) {
+    case 1:
+      return "2x";
+    case 2:
+      return "1x";
+    default:
+      return "oversampled";
+  }
+}
+
+struct Case
+{
+  bool isSinglePrecision = false;
+  int oversamplingOrder = 1;
+  bool isLinearPhase = false;
+  int numKnots = 4;
+  bool isUsingGainTable = false;
+  int highPassOrder = 0;
+  Topology topology = Topology::forward;
+  int blockSize = 128;
+  // as the Detector-Rate parameter: 0 oversampled, 1 twice the sample rate,
+  // 2 the sample rate
+  int detectorRate = 0;
+  bool isGainBandLimited = false;
+  // multiband, the bands above the first one repeat its settings
+  int numBands = 1;
+
+  bool operator==(Case const&) const = default;
+};
+
+struct Result
+{
+  double nsPerSample;
+  double realTimeFactor;
+  double p50;
+  double p90;
+  double p99;
+  double max;
+};
+
+struct Settings
+{
+  double sampleRate = 48000.0;
+  double seconds = 2.0;
+  // not measured, lets the oversamplers fill and the gain table settle
+  double warmUpSeconds = 0.5;
+};
+
+// stereo noise with a slow level modulation, so that the detector moves
+template<class FloatType>
+std::vector<FloatType>
+makeSignal(int const numSamples, unsigned const seed)
+{
+  auto signal = std::vector<FloatType>(2 * numSamples);
+  auto generator = std::minstd_rand(seed);
+  auto noise = std::uniform_real_distribution<double>(-1.0, 1.0);
+  for (int i = 0; i < numSamples; ++i) {
+    double const level = 0.5 + 0.45 * std::sin(i * 1e-4);
+    signal[i] = static_cast<FloatType>(level * noise(generator));
+    signal[numSamples + i] = static_cast<FloatType>(level * noise(generator));
+  }
+  return signal;
+}
+
+// see getVecBuffer in Processing.cpp
+template<class FloatType, class InterleavedBuffer>
+auto&
+getStereoVecBuffer(InterleavedBuffer& buffer)
+{
+  if constexpr (std::is_same_v<FloatType, double>) {
+    return buffer.getBuffer2(0);
+  }
+  else {
+    return buffer.getBuffer4(0);
+  }
+}
+
+// Lets --aliasing and --precision render a signal through run and read the
+// output. With an amplitude, a sine is fed to both channels, otherwise the
+// noise of the benchmark, rounded to single precision as a host buffer would
+// be, so that both precisions process the same input. The left channel of
+// the blocks after the warm-up, at least numOutputSamples of them, is
+// appended to output. The detector is made faster and the mix fully wet, to
+// stress the gain stage.
+
+struct Probe
+{
+  double omega = 0.0;
+  double amplitude = 0.0;
+  int numOutputSamples = 0;
+  std::vector<double> output;
+};
+
+template<class FloatType>
+Result
+run(Case const& c, Settings const& settings, Probe* probe = nullptr)
+{
+  using Vec =
+    std::conditional_t<std::is_same_v<FloatType, double>, Vec2d, Vec4f>;
+  using Dsp = curvessor::TDsp<Vec>;
+  using Oversampling = oversimple::TOversampling<FloatType>;
+
+  int const blockSize = c.blockSize;
+
+  auto oversamplingSettings = oversimple::OversamplingSettings{};
+  oversamplingSettings.numUpSampledChannels = 2;
+  oversamplingSettings.numDownSampledChannels = 2;
+  oversamplingSettings.upSampleOutputBufferType =
+    oversimple::BufferType::interleaved;
+  oversamplingSettings.downSampleInputBufferType =
+    oversimple::BufferType::interleaved;
+  oversamplingSettings.downSampleOutputBufferType =
+    oversimple::BufferType::interleaved;
+  oversamplingSettings.order = c.oversamplingOrder;
+  oversamplingSettings.isUsingLinearPhase = c.isLinearPhase;
+  oversamplingSettings.maxNumInputSamples = static_cast<uint32_t>(blockSize);
+
+  auto wetOversampling = Oversampling(oversamplingSettings);
+  auto dryOversampling = Oversampling(oversamplingSettings);
+  auto sidechainOversampling = Oversampling(oversamplingSettings);
+  for (auto* oversampling :
+       { &wetOversampling, &dryOversampling, &sidechainOversampling }) {
+    oversampling->prepareBuffers(static_cast<uint32_t>(blockSize));
+  }
+
+  // like the Auto dry path: a delay with linear phase, otherwise a second
+  // oversampler to match the phase response
+  double const wetLatency = wetOversampling.getLatency();
+  auto dryDelay = curvessor::DryDelay<Vec>();
+  dryDelay.prepare(static_cast<int>(std::ceil(wetLatency)) + 1, blockSize);
+  bool const isDryPathDelayed = c.isLinearPhase || c.oversamplingOrder == 0;
+
+  auto dsp = Aligned<Dsp>::make();
+
+  alignas(sizeof(Vec)) FloatType wetAmount[Vec::size()] = {};
+
+  int const oversamplingRate =
+    static_cast<int>(wetOversampling.getOversamplingRate());
+  int const detectorDecimation = [&] {
+    switch (c.detectorRate) {
+      case 1:
+        return std::max(1, oversamplingRate / 2);
+      case 2:
+        return oversamplingRate;
+      default:
+        return 1;
+    }
+  }();
+  dsp->detectorDecimation = detectorDecimation;
+  dsp->setGainBandLimit(c.isGainBandLimited, oversamplingRate);
+
+  // the settings of the kernels are for the rate of the detector
+  double const detectorSampleRate =
+    settings.sampleRate * oversamplingRate / detectorDecimation;
+  double const angularFrequencyCoef =
+    1000.0 * 2.0 * std::numbers::pi / detectorSampleRate;
+
+  // 50 ms smoothing, 10 ms attack, 100 ms release, 40 Hz high-pass, or
+  // 0.5 ms attack and 20 ms release when probing
+  double const attackMs = probe ? 0.5 : 10.0;
+  double const releaseMs = probe ? 20.0 : 100.0;
+  dsp->setAutomationAlpha(std::exp(-angularFrequencyCoef / 50.0));
+  auto envelopeFollowerSettings =
+    adsp::GammaEnvSettings<Vec>(dsp->envelopeFollower);
+  for (int lane = 0; lane < 2; ++lane) {
+    envelopeFollowerSettings.setup(lane,
+                                   0.0,
+                                   angularFrequencyCoef / attackMs,
+                                   angularFrequencyCoef / releaseMs,
+                                   0.0,
+                                   0.0);
+    double const g = std::tan(std::numbers::pi * 40.0 / detectorSampleRate);
+    dsp->highPassCoef[lane] = g / (1.0 + g);
+    dsp->stereoLink[lane] = dsp->stereoLinkTarget[lane] = 0.5;
+    dsp->inputGain[lane] = 1.0;
+    dsp->outputGain[lane] = 1.0;
+    wetAmount[lane] = probe ? 1.0 : 0.5;
+    dsp->feedbackAmountTarget[lane] =
+      c.topology == Topology::feedback ? 0.5 : 0.0;
+    dsp->feedbackAmount[lane] = dsp->feedbackAmountTarget[lane];
+  }
+
+  // Multiband, as Chain::upperBands in PluginProcessor.h: the crossover
+  // splits the upsampled signal, and the sidechain, at 200 Hz and 2 kHz.
+  int const numBands = std::clamp(c.numBands, 1, curvessor::maxNumBands);
+  int const numUpsampledSamples = blockSize * oversamplingRate;
+  double const crossoverFrequencies[] = { 200.0, 2000.0 };
+
+  auto crossover = curvessor::Crossover<Vec>();
+  auto sidechainCrossover = curvessor::Crossover<Vec>();
+  for (auto* splitter : { &crossover, &sidechainCrossover }) {
+    splitter->setup(
+      crossoverFrequencies, numBands, settings.sampleRate * oversamplingRate);
+  }
+
+  std::array<aligned_ptr<Dsp>, curvessor::maxNumBands - 1> upperDsps;
+  std::array<VecBuffer<Vec>, curvessor::maxNumBands - 1> upperIoBuffers;
+  std::array<VecBuffer<Vec>, curvessor::maxNumBands - 1> upperSidechains;
+  VecBuffer<Vec>* upperIo[curvessor::maxNumBands - 1] = {};
+  VecBuffer<Vec>* upperSidechain[curvessor::maxNumBands - 1] = {};
+
+  for (int band = 1; band < numBands; ++band) {
+    auto& upperDsp = upperDsps[band - 1];
+    upperDsp = Aligned<Dsp>::make();
+    upperDsp->copySharedSettings(*dsp);
+    auto bandEnvelopeFollowerSettings =
+      adsp::GammaEnvSettings<Vec>(upperDsp->envelopeFollower);
+    for (int lane = 0; lane < 2; ++lane) {
+      bandEnvelopeFollowerSettings.setup(lane,
+                                         0.0,
+                                         angularFrequencyCoef / attackMs,
+                                         angularFrequencyCoef / releaseMs,
+                                         0.0,
+                                         0.0);
+      upperDsp->stereoLink[lane] = dsp->stereoLink[lane];
+      upperDsp->feedbackAmount[lane] = dsp->feedbackAmount[lane];
+    }
+    upperIoBuffers[band - 1].setNumSamples(numUpsampledSamples);
+    upperSidechains[band - 1].setNumSamples(numUpsampledSamples);
+    upperIo[band - 1] = &upperIoBuffers[band - 1];
+    upperSidechain[band - 1] = &upperSidechains[band - 1];
+  }
+
+  auto const getBandDsp = [&](int const band) -> Dsp& {
+    return band == 0 ? *dsp : *upperDsps[band - 1];
+  };
+
+  int const numWarmUpBlocks =
+    static_cast<int>(settings.warmUpSeconds * settings.sampleRate) / blockSize;
+  int const numBlocks = std::max(
+    { 1,
+      static_cast<int>(settings.seconds * settings.sampleRate) / blockSize,
+      probe ? (probe->numOutputSamples + blockSize - 1) / blockSize : 0 });
+  int const numSignalSamples = (numWarmUpBlocks + numBlocks) * blockSize;
+
+  auto input = makeSignal<FloatType>(numSignalSamples, 1);
+  if (probe && probe->amplitude > 0.0) {
+    for (int i = 0; i < numSignalSamples; ++i) {
+      auto const x =
+        static_cast<FloatType>(probe->amplitude * std::sin(probe->omega * i));
+      input[i] = input[numSignalSamples + i] = x;
+    }
+  }
+  else if (probe) {
+    for (auto& x : input) {
+      x = static_cast<FloatType>(static_cast<float>(x));
+    }
+  }
+  auto const sidechainInput = makeSignal<FloatType>(numSignalSamples, 2);
+
+  auto io = std::vector<FloatType>(2 * blockSize);
+  auto dry = std::vector<FloatType>(2 * blockSize);
+  FloatType* dryChannels[2] = { dry.data(), dry.data() + blockSize };
+  auto sidechain = std::vector<FloatType>(2 * blockSize);
+  FloatType* ioChannels[2] = { io.data(), io.data() + blockSize };
+  FloatType* sidechainChannels[2] = { sidechain.data(),
+                                      sidechain.data() + blockSize };
+
+  auto blockNsPerSample = std::vector<double>();
+  blockNsPerSample.reserve(numBlocks);
+  double totalNs = 0.0;
+
+  for (int block = 0; block < numWarmUpBlocks + numBlocks; ++block) {
+    int const offset = block * blockSize;
+    for (int ch = 0; ch < 2; ++ch) {
+      std::copy_n(
+        &input[ch * numSignalSamples + offset], blockSize, ioChannels[ch]);
+      std::copy_n(&sidechainInput[ch * numSignalSamples + offset],
+                  blockSize,
+                  sidechainChannels[ch]);
+    }
+
+    auto const start = std::chrono::steady_clock::now();
+
+    auto const numInputSamples = static_cast<uint32_t>(blockSize);
+
+    if (c.isUsingGainTable) {
+      for (int band = 0; band < numBands; ++band) {
+        getBandDsp(band).updateGainTable(c.numKnots);
+      }
+    }
+
+    // input stage at unity gain
+    curvessor::prepareInput(ioChannels,
+                            ioChannels,
+                            dryChannels,
+                            2,
+                            blockSize,
+                            false,
+                            true,
+                            dsp->inputGain,
+                            dsp->inputGain,
+                            dsp->automationAlpha);
+
+    Vec const* delayedDry = nullptr;
+    if (isDryPathDelayed) {
+      delayedDry = dryDelay.process(dryChannels, 2, blockSize, wetLatency);
+    }
+    else {
+      dryOversampling.upSample(dryChannels, numInputSamples);
+    }
+
+    wetOversampling.upSample(ioChannels, numInputSamples);
+    auto& upsampledBuffer = wetOversampling.getUpSampleOutputInterleaved();
+    auto& upsampledIo = getStereoVecBuffer<FloatType>(upsampledBuffer);
+
+    bool const isSidechain = c.topology == Topology::sidechain;
+    if (isSidechain) {
+      sidechainOversampling.upSample(sidechainChannels, numInputSamples);
+    }
+    auto& upsampledSidechain =
+      isSidechain ? getStereoVecBuffer<FloatType>(
+                      sidechainOversampling.getUpSampleOutputInterleaved())
+                  : upsampledIo;
+
+    if (numBands > 1) {
+      crossover.split(upsampledIo, upperIo, numUpsampledSamples);
+      if (isSidechain) {
+        sidechainCrossover.split(
+          upsampledSidechain, upperSidechain, numUpsampledSamples);
+      }
+    }
+
+    for (int band = 0; band < numBands; ++band) {
+      auto& bandDsp = getBandDsp(band);
+      auto& bandIo = band == 0 ? upsampledIo : *upperIo[band - 1];
+      auto& bandSidechain =
+        band == 0 ? upsampledSidechain : *upperSidechain[band - 1];
+      switch (c.topology) {
+        case Topology::sidechain:
+          bandDsp.sidechainProcess(
+            bandIo, bandSidechain, c.numKnots, c.highPassOrder);
+          break;
+        case Topology::feedback:
+          bandDsp.feedbackProcess(bandIo, c.numKnots, c.highPassOrder);
+          break;
+        case Topology::forward:
+          bandDsp.forwardProcess(bandIo, c.numKnots, c.highPassOrder);
+          break;
+      }
+    }
+
+    if (numBands > 1) {
+      crossover.sum(upsampledIo, upperIo, numUpsampledSamples);
+    }
+
+    wetOversampling.downSample(upsampledBuffer, numInputSamples);
+    if (!isDryPathDelayed) {
+      dryOversampling.downSample(dryOversampling.getUpSampleOutputInterleaved(),
+                                 numInputSamples);
+      delayedDry = &getStereoVecBuffer<FloatType>(
+        dryOversampling.getDownSampleOutputInterleaved())[0];
+    }
+
+    // a half wet mix, the most expensive output stage
+    auto output = curvessor::OutputStage<Vec>{};
+    output.wet = &getStereoVecBuffer<FloatType>(
+      wetOversampling.getDownSampleOutputInterleaved())[0];
+    output.dry = delayedDry;
+    output.isMixing = true;
+    output.wetAmount = wetAmount;
+    output.wetAmountTarget = wetAmount;
+    output.outputGain = dsp->outputGain;
+    output.outputGainTarget = dsp->outputGain;
+    output.alpha = dsp->automationAlpha;
+    output.process(ioChannels, blockSize);
+
+    auto const end = std::chrono::steady_clock::now();
+
+    if (probe && block >= numWarmUpBlocks) {
+      probe->output.insert(
+        probe->output.end(), ioChannels[0], ioChannels[0] + blockSize);
+    }
+
+    if (block >= numWarmUpBlocks) {
+      double const ns = static_cast<double>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+          .count());
+      totalNs += ns;
+      blockNsPerSample.push_back(ns / blockSize);
+    }
+  }
+
+  std::sort(blockNsPerSample.begin(), blockNsPerSample.end());
+  auto const percentile = [&](double const p) {
+    auto const rank = static_cast<size_t>(
+      std::ceil(p * 0.01 * blockNsPerSample.size()));
+    return blockNsPerSample[std::clamp<size_t>(
+      rank, 1, blockNsPerSample.size()) - 1];
+  };
+
+  double const numSamples = static_cast<double>(numBlocks) * blockSize;
+  double const audioNs = 1e9 * numSamples / settings.sampleRate;
+
+  return { totalNs / numSamples,   audioNs / totalNs, percentile(50.0),
+           percentile(90.0),       percentile(99.0),  blockNsPerSample.back() };
+}
+
+// The delay of the wet oversampling path, up and down sampling only. An
+// impulse gives a coarse estimate at the peak of the response, which the
+// phase of a low frequency sine refines, within half its period, to the
+// delay that aligns the passband with the dry signal.
+
+struct LatencyResult
+{
+  double reported;
+  int reportedSamples;
+  double measured;
+};
+
+inline constexpr double maxLatencyError = 1.0;
+
+LatencyResult
+measureLatency(int const oversamplingOrder,
+               bool const isLinearPhase,
+               Settings const& settings)
+{
+  using Oversampling = oversimple::TOversampling<double>;
+
+  constexpr int blockSize = 256;
+
+  auto oversamplingSettings = oversimple::OversamplingSettings{};
+  oversamplingSettings.numUpSampledChannels = 2;
+  oversamplingSettings.numDownSampledChannels = 2;
+  oversamplingSettings.upSampleOutputBufferType =
+    oversimple::BufferType::interleaved;
+  oversamplingSettings.downSampleInputBufferType =
+    oversimple::BufferType::interleaved;
+  oversamplingSettings.downSampleOutputBufferType =
+    oversimple::BufferType::interleaved;
+  oversamplingSettings.order = oversamplingOrder;
+  oversamplingSettings.isUsingLinearPhase = isLinearPhase;
+  oversamplingSettings.maxNumInputSamples = blockSize;
+
+  auto oversampling = Oversampling(oversamplingSettings);
+  oversampling.prepareBuffers(blockSize);
+
+  double const reported = oversampling.getLatency();
+
+  // renders the first numSamples samples of the output for an input
+  auto const render = [&](auto const& input, int const numSamples) {
+    oversampling.reset();
+    auto output = std::vector<double>(numSamples);
+    double block[2][blockSize];
+    double* channels[2] = { block[0], block[1] };
+    for (int offset = 0; offset < numSamples; offset += blockSize) {
+      for (int i = 0; i < blockSize; ++i) {
+        block[0][i] = block[1][i] = input(offset + i);
+      }
+      oversampling.upSample(channels, blockSize);
+      oversampling.downSample(oversampling.getUpSampleOutputInterleaved(),
+                              blockSize);
+      oversampling.getDownSampleOutputInterleaved().deinterleave(
+        channels, 2, blockSize);
+      std::copy_n(
+        block[0], std::min(blockSize, numSamples - offset), &output[offset]);
+    }
+    return output;
+  };
+
+  int const impulseLength =
+    blockSize * (2 + static_cast<int>(std::ceil(2.0 * reported)) / blockSize);
+
+  auto const impulseResponse =
+    render([](int i) { return i == 0 ? 1.0 : 0.0; }, impulseLength);
+
+  auto const isSmaller = [](double a, double b) {
+    return std::abs(a) < std::abs(b);
+  };
+  int const peak = static_cast<int>(
+    std::max_element(
+      impulseResponse.begin(), impulseResponse.end(), isSmaller) -
+    impulseResponse.begin());
+
+  // a whole number of periods past the impulse response
+  double const frequency = 200.0;
+  double const omega = 2.0 * std::numbers::pi * frequency / settings.sampleRate;
+  int const period =
+    static_cast<int>(std::lround(settings.sampleRate / frequency));
+  int const windowLength = 50 * period;
+  int const windowStart = impulseLength;
+
+  auto const sineResponse =
+    render([&](int i) { return std::sin(omega * i); },
+           windowStart + windowLength);
+
+  double inPhase = 0.0;
+  double quadrature = 0.0;
+  for (int i = windowStart; i < windowStart + windowLength; ++i) {
+    inPhase += sineResponse[i] * std::sin(omega * i);
+    quadrature += sineResponse[i] * std::cos(omega * i);
+  }
+
+  // the phase delay in samples, unwrapped around the peak of the impulse
+  double const phaseDelay = std::atan2(-quadrature, inPhase) / omega;
+  double const cycle = 2.0 * std::numbers::pi / omega;
+  double const measured =
+    phaseDelay + cycle * std::round((peak - phaseDelay) / cycle);
+
+  return { reported, static_cast<int>(std::lround(reported)), measured };
+}
+
+int
+checkLatency(Settings const& settings, FILE* out)
+{
+  std::fprintf(out,
+               "{\n  \"sampleRate\": %g,\n  \"maxError\": %g,\n"
+               "  \"cases\": [\n",
+               settings.sampleRate,
+               maxLatencyError);
+
+  bool isPassing = true;
+
+  for (int order = 0; order <= 5; ++order) {
+    for (bool const isLinearPhase : { false, true }) {
+      auto const r = measureLatency(order, isLinearPhase, settings);
+      double const error = r.measured - r.reportedSamples;
+      bool const isCorrect = std::abs(error) <= maxLatencyError;
+      isPassing = isPassing && isCorrect;
+      std::fprintf(out,
+                   "    { \"oversampling\": %d, \"linearPhase\": %s, "
+                   "\"reported\": %.3f, \"reportedSamples\": %d, "
+                   "\"measured\": %.3f, \"error\": %.3f, "
+                   "\"pass\": %s }%s\n",
+                   1 << order,
+                   isLinearPhase ? "true" : "false",
+                   r.reported,
+                   r.reportedSamples,
+                   r.measured,
+                   error,
+                   isCorrect ? "true" : "false",
+                   order == 5 && isLinearPhase ? "" : ",");
+    }
+  }
+
+  std::fprintf(
+    out, "  ],\n  \"pass\": %s\n}\n", isPassing ? "true" : "false");
+
+  return isPassing ? 0 : 1;
+}
+
+// Aliasing of the gain stage. A sine, centered on a bin of the analysis, is
+// compressed by a fast detector, so that its gain moves at audio rate. The
+// output should only hold the harmonics of the sine: the power in every other
+// bin but DC is aliasing, or noise, and is measured against the power of the
+// fundamental, through a Blackman-Harris window.
+
+inline constexpr int aliasingFftSize = 1 << 16;
+// prime, so that the aliases of the harmonics fall between them
+inline constexpr int aliasingSineBin = 13001;
+// half the main lobe of the window, in bins
+inline constexpr int aliasingLobeBins = 4;
+// The band-limited gain with the detector at 1x and the audio at 2x and 4x
+// must come this close to full rate oversampling at twice the rate, 4x and
+// 8x, which it is meant to stand in for.
+inline constexpr double maxAliasingShortfallDb = 6.0;
+
+void
+fft(std::vector<std::complex<double>>& x)
+{
+  int const n = static_cast<int>(x.size());
+  for (int i = 1, j = 0; i < n; ++i) {
+    int bit = n >> 1;
+    for (; j & bit; bit >>= 1) {
+      j ^= bit;
+    }
+    j ^= bit;
+    if (i < j) {
+      std::swap(x[i], x[j]);
+    }
+  }
+  for (int length = 2; length <= n; length <<= 1) {
+    double const angle = -2.0 * std::numbers::pi / length;
+    for (int i = 0; i < n; i += length) {
+      for (int k = 0; k < length / 2; ++k) {
+        auto const w = std::polar(1.0, angle * k);
+        auto const a = x[i + k];
+        auto const b = x[i + k + length / 2] * w;
+        x[i + k] = a + b;
+        x[i + k + length / 2] = a - b;
+      }
+    }
+  }
+}
+
+struct AliasingResult
+{
+  double rejectionDb;
+  double nsPerSample;
+};
+
+AliasingResult
+measureAliasing(Case const& c, Settings const& settings)
+{
+  constexpr int n = aliasingFftSize;
+
+  auto probe = Probe{};
+  probe.omega = 2.0 * std::numbers::pi * aliasingSineBin / n;
+  probe.amplitude = 0.5;
+  probe.numOutputSamples = n;
+
+  auto const result = c.isSinglePrecision ? run<float>(c, settings, &probe)
+                                          : run<double>(c, settings, &probe);
+
+  auto spectrum = std::vector<std::complex<double>>(n);
+  for (int i = 0; i < n; ++i) {
+    double const phase = 2.0 * std::numbers::pi * i / n;
+    double const window = 0.35875 - 0.48829 * std::cos(phase) +
+                          0.14128 * std::cos(2.0 * phase) -
+                          0.01168 * std::cos(3.0 * phase);
+    spectrum[i] = probe.output[i] * window;
+  }
+  fft(spectrum);
+
+  double fundamental = 0.0;
+  double aliasing = 0.0;
+  for (int k = aliasingLobeBins + 1; k <= n / 2; ++k) {
+    int const harmonic =
+      (k + aliasingSineBin / 2) / aliasingSineBin * aliasingSineBin;
+    bool const isHarmonic =
+      harmonic > 0 && std::abs(k - harmonic) <= aliasingLobeBins;
+    double const power = std::norm(spectrum[k]);
+    if (isHarmonic && harmonic == aliasingSineBin) {
+      fundamental += power;
+    }
+    else if (!isHarmonic) {
+      aliasing += power;
+    }
+  }
+
+  double const rejectionDb =
+    10.0 * std::log10(fundamental / std::max(aliasing, 1e-300));
+
+  return { rejectionDb, result.nsPerSample };
+}
+
+int
+printAliasing(Settings const& settings, FILE* out)
+{
+  // full rate oversampling, then the split rate and band-limited engines
+  auto cases = std::vector<Case>();
+  for (int order = 0; order <= 3; ++order) {
+    auto c = Case{};
+    c.oversamplingOrder = order;
+    cases.push_back(c);
+  }
+  for (int order = 0; order <= 2; ++order) {
+    for (bool const isGainBandLimited : { false, true }) {
+      if (order == 0 && !isGainBandLimited) {
+        continue;
+      }
+      auto c = Case{};
+      c.oversamplingOrder = order;
+      c.detectorRate = 2;
+      c.isGainBandLimited = isGainBandLimited;
+      cases.push_back(c);
+    }
+  }
+
+  std::fprintf(out,
+               "{\n  \"sampleRate\": %g,\n  \"sineFrequency\": %g,\n"
+               "  \"maxShortfallDb\": %g,\n  \"cases\": [\n",
+               settings.sampleRate,
+               settings.sampleRate * aliasingSineBin / aliasingFftSize,
+               maxAliasingShortfallDb);
+
+  // the full rate cases come first, by oversampling order
+  double fullRateRejectionDb[4] = {};
+  bool isPassing = true;
+
+  for (size_t i = 0; i < cases.size(); ++i) {
+    auto const& c = cases[i];
+    std::fprintf(stderr, "case %zu/%zu\r", i + 1, cases.size());
+    auto const r = measureAliasing(c, settings);
+
+    bool const isFullRate = c.detectorRate == 0;
+    if (isFullRate) {
+      fullRateRejectionDb[c.oversamplingOrder] = r.rejectionDb;
+    }
+
+    bool const isChecked = c.isGainBandLimited && c.oversamplingOrder >= 1;
+    double const targetDb =
+      isChecked ? fullRateRejectionDb[c.oversamplingOrder + 1] -
+                    maxAliasingShortfallDb
+                : 0.0;
+    bool const isOnTarget = !isChecked || r.rejectionDb >= targetDb;
+    isPassing = isPassing && isOnTarget;
+
+    std::fprintf(out,
+                 "    { \"oversampling\": %d, \"detectorRate\": \"%s\", "
+                 "\"bandLimitedGain\": %s, \"aliasRejectionDb\": %.1f, "
+                 "\"nsPerSample\": %.3f",
+                 1 << c.oversamplingOrder,
+                 toDetectorRateString(c.detectorRate),
+                 c.isGainBandLimited ? "true" : "false",
+                 r.rejectionDb,
+                 r.nsPerSample);
+    if (isChecked) {
+      std::fprintf(out,
+                   ", \"targetDb\": %.1f, \"pass\": %s",
+                   targetDb,
+                   isOnTarget ? "true" : "false");
+    }
+    std::fprintf(out, " }%s\n", i + 1 < cases.size() ? "," : "");
+  }
+
+  std::fprintf(
+    out, "  ],\n  \"pass\": %s\n}\n", isPassing ? "true" : "false");
+  std::fprintf(stderr, "\n");
+  return isPassing ? 0 : 1;
+}
+
+// The stages around the oversamplers, fused as in BlockStages.h and as the
+// separate passes they replaced, timed on the same blocks of a single
+// precision host buffer. Before the oversamplers: the conversion to the
+// precision of the chain, the dry copy and the input gain; after them: the
+// dry-wet mix with the output gain, the deinterleaving and the conversion
+// back. A single precision chain processes the host buffer in place when not
+// fused. Each pipeline has its own 1x oversampler, run between the stages
+// outside of the timing, and its own dry delay, timed with the input stage.
+
+struct FusionResult
+{
+  double fusedNsPerSample;
+  double unfusedNsPerSample;
+};
+
+template<class FloatType>
+FusionResult
+measureFusion(int const blockSize, Settings const& settings)
+{
+  using Vec =
+    std::conditional_t<std::is_same_v<FloatType, double>, Vec2d, Vec4f>;
+  using Oversampling = oversimple::TOversampling<FloatType>;
+  using Clock = std::chrono::steady_clock;
+  constexpr int numLanes = Vec::size();
+
+  auto oversamplingSettings = oversimple::OversamplingSettings{};
+  oversamplingSettings.numUpSampledChannels = 2;
+  oversamplingSettings.numDownSampledChannels = 2;
+  oversamplingSettings.upSampleOutputBufferType =
+    oversimple::BufferType::interleaved;
+  oversamplingSettings.downSampleInputBufferType =
+    oversimple::BufferType::interleaved;
+  oversamplingSettings.downSampleOutputBufferType =
+    oversimple::BufferType::interleaved;
+  oversamplingSettings.order = 0;
+  oversamplingSettings.maxNumInputSamples = static_cast<uint32_t>(blockSize);
+
+  struct Pipeline
+  {
+    Oversampling oversampling;
+    curvessor::DryDelay<Vec> dryDelay;
+    std::vector<FloatType> io;
+    std::vector<FloatType> dry;
+    FloatType* ioChannels[2];
+    FloatType* dryChannels[2];
+    alignas(sizeof(Vec)) FloatType inputGain[numLanes];
+    alignas(sizeof(Vec)) FloatType wetAmount[numLanes];
+    alignas(sizeof(Vec)) FloatType outputGain[numLanes];
+    double ns = 0.0;
+
+    Pipeline(oversimple::OversamplingSettings const& settings, int n)
+      : oversampling(settings)
+      , io(2 * n)
+      , dry(2 * n)
+      , ioChannels{ io.data(), io.data() + n }
+      , dryChannels{ dry.data(), dry.data() + n }
+    {
+      oversampling.prepareBuffers(static_cast<uint32_t>(n));
+      dryDelay.prepare(1, n);
+      std::fill_n(inputGain, numLanes, FloatType(1));
+      std::fill_n(wetAmount, numLanes, FloatType(1));
+      std::fill_n(outputGain, numLanes, FloatType(1));
+    }
+  };
+
+  auto fused = Pipeline(oversamplingSettings, blockSize);
+  auto unfused = Pipeline(oversamplingSettings, blockSize);
+
+  alignas(sizeof(Vec)) FloatType inputGainTarget[numLanes];
+  alignas(sizeof(Vec)) FloatType wetAmountTarget[numLanes];
+  alignas(sizeof(Vec)) FloatType outputGainTarget[numLanes];
+  std::fill_n(inputGainTarget, numLanes, FloatType(0.5));
+  std::fill_n(wetAmountTarget, numLanes, FloatType(0.5));
+  std::fill_n(outputGainTarget, numLanes, FloatType(0.8));
+  auto const alpha = FloatType(0.999);
+
+  int const numBlocks = std::max(
+    1, static_cast<int>(settings.seconds * settings.sampleRate) / blockSize);
+  int const numSignalSamples = numBlocks * blockSize;
+  auto const input = makeSignal<float>(numSignalSamples, 1);
+
+  auto host = std::vector<float>(2 * blockSize);
+  float* hostChannels[2] = { host.data(), host.data() + blockSize };
+
+  auto const loadBlock = [&](int const block) {
+    for (int ch = 0; ch < 2; ++ch) {
+      std::copy_n(&input[ch * numSignalSamples + block * blockSize],
+                  blockSize,
+                  hostChannels[ch]);
+    }
+  };
+
+  auto const elapsedNs = [](Clock::time_point const start) {
+    return static_cast<double>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                           start)
+        .count());
+  };
+
+  auto const numInputSamples = static_cast<uint32_t>(blockSize);
+
+  for (int block = 0; block < numBlocks; ++block) {
+    // fused
+    {
+      auto& p = fused;
+      loadBlock(block);
+
+      auto start = Clock::now();
+      curvessor::prepareInput(hostChannels,
+                              p.ioChannels,
+                              p.dryChannels,
+                              2,
+                              blockSize,
+                              false,
+                              true,
+                              inputGainTarget,
+                              p.inputGain,
+                              alpha);
+      Vec const* delayedDry =
+        p.dryDelay.process(p.dryChannels, 2, blockSize, 0.0);
+      p.ns += elapsedNs(start);
+
+      p.oversampling.upSample(p.ioChannels, numInputSamples);
+      p.oversampling.downSample(p.oversampling.getUpSampleOutputInterleaved(),
+                                numInputSamples);
+
+      start = Clock::now();
+      auto output = curvessor::OutputStage<Vec>{};
+      output.wet = &getStereoVecBuffer<FloatType>(
+        p.oversampling.getDownSampleOutputInterleaved())[0];
+      output.dry = delayedDry;
+      output.isMixing = true;
+      output.wetAmount = p.wetAmount;
+      output.wetAmountTarget = wetAmountTarget;
+      output.outputGain = p.outputGain;
+      output.outputGainTarget = outputGainTarget;
+      output.alpha = alpha;
+      output.process(hostChannels, blockSize);
+      p.ns += elapsedNs(start);
+    }
+
+    // unfused
+    {
+      auto& p = unfused;
+      loadBlock(block);
+
+      auto start = Clock::now();
+      FloatType* audio[2] = { p.ioChannels[0], p.ioChannels[1] };
+      if constexpr (std::is_same_v<FloatType, float>) {
+        audio[0] = hostChannels[0];
+        audio[1] = hostChannels[1];
+      }
+      else {
+        for (int ch = 0; ch < 2; ++ch) {
+          for (int i = 0; i < blockSize; ++i) {
+            audio[ch][i] = static_cast<FloatType>(hostChannels[ch][i]);
+          }
+        }
+      }
+      for (int ch = 0; ch < 2; ++ch) {
+        std::copy_n(audio[ch], blockSize, p.dryChannels[ch]);
+      }
+      Vec const* delayedDry =
+        p.dryDelay.process(p.dryChannels, 2, blockSize, 0.0);
+      for (int ch = 0; ch < 2; ++ch) {
+        FloatType gain = p.inputGain[ch];
+        for (int i = 0; i < blockSize; ++i) {
+          gain = inputGainTarget[ch] + alpha * (gain - inputGainTarget[ch]);
+          audio[ch][i] *= gain;
+        }
+        p.inputGain[ch] = gain;
+      }
+      p.ns += elapsedNs(start);
+
+      p.oversampling.upSample(audio, numInputSamples);
+      p.oversampling.downSample(p.oversampling.getUpSampleOutputInterleaved(),
+                                numInputSamples);
+
+      start = Clock::now();
+      auto& wetOutput = p.oversampling.getDownSampleOutputInterleaved();
+      auto& wet = getStereoVecBuffer<FloatType>(wetOutput);
+      Vec const alphaVec = alpha;
+      Vec amount = Vec().load_a(p.wetAmount);
+      Vec const amountTarget = Vec().load_a(wetAmountTarget);
+      Vec gain = Vec().load_a(p.outputGain);
+      Vec const gainTarget = Vec().load_a(outputGainTarget);
+      for (int i = 0; i < blockSize; ++i) {
+        amount = amountTarget + alphaVec * (amount - amountTarget);
+        gain = gainTarget + alphaVec * (gain - gainTarget);
+        Vec const dry = delayedDry[i];
+        wet[i] = amount * (gain * wet[i] - dry) + dry;
+      }
+      amount.store_a(p.wetAmount);
+      gain.store_a(p.outputGain);
+      wetOutput.deinterleave(audio, 2, blockSize);
+      if constexpr (std::is_same_v<FloatType, double>) {
+        for (int ch = 0; ch < 2; ++ch) {
+          for (int i = 0; i < blockSize; ++i) {
+            hostChannels[ch][i] = static_cast<float>(audio[ch][i]);
+          }
+        }
+      }
+      p.ns += elapsedNs(start);
+    }
+  }
+
+  double const numSamples = static_cast<double>(numSignalSamples);
+  return { fused.ns / numSamples, unfused.ns / numSamples };
+}
+
+int
+printFusion(Settings const& settings, FILE* out)
+{
+  std::fprintf(out,
+               "{\n  \"sampleRate\": %g,\n  \"seconds\": %g,\n"
+               "  \"cases\": [\n",
+               settings.sampleRate,
+               settings.seconds);
+
+  auto const blockSizes = { 32, 64, 128, 256, 512, 1024 };
+  int const numCases = 2 * static_cast<int>(blockSizes.size());
+  int caseIndex = 0;
+
+  for (bool const isSinglePrecision : { false, true }) {
+    for (int const blockSize : blockSizes) {
+      ++caseIndex;
+      std::fprintf(stderr, "case %d/%d\r", caseIndex, numCases);
+      auto const r = isSinglePrecision
+                       ? measureFusion<float>(blockSize, settings)
+                       : measureFusion<double>(blockSize, settings);
+      std::fprintf(out,
+                   "    { \"precision\": \"%s\", \"blockSize\": %d, "
+                   "\"fusedNsPerSample\": %.3f, "
+                   "\"unfusedNsPerSample\": %.3f, \"speedup\": %.2f }%s\n",
+                   isSinglePrecision ? "float" : "double",
+                   blockSize,
+                   r.fusedNsPerSample,
+                   r.unfusedNsPerSample,
+                   r.unfusedNsPerSample / r.fusedNsPerSample,
+                   caseIndex < numCases ? "," : "");
+    }
+  }
+
+  std::fprintf(out, "  ]\n}\n");
+  std::fprintf(stderr, "\n");
+  return 0;
+}
+
+// The error of the approximated dB to linear tiers of GainMath.h against the
+// exact conversion, computed with std::exp in double precision, over a sweep
+// of gains in steps of a thousandth of a dB. Each tier is checked in single
+// and double precision against its bound.
+
+inline constexpr double minSweptGainDb = -200.0;
+inline constexpr double maxSweptGainDb = 60.0;
+inline constexpr double sweptGainStepDb = 0.001;
+
+template<curvessor::GainAccuracy accuracy, class Vec>
+double
+measureGainError()
+{
+  using Float = std::remove_cvref_t<decltype(std::declval<Vec const&>()[0])>;
+  constexpr int numLanes = Vec::size();
+  constexpr double ln10 = 2.30258509299404568402;
+
+  int const numSteps = static_cast<int>(
+    std::lround((maxSweptGainDb - minSweptGainDb) / sweptGainStepDb));
+
+  double maxError = 0.0;
+  alignas(sizeof(Vec)) Float db[numLanes];
+  alignas(sizeof(Vec)) Float gain[numLanes];
+  for (int step = 0; step <= numSteps; step += numLanes) {
+    for (int lane = 0; lane < numLanes; ++lane) {
+      db[lane] = static_cast<Float>(minSweptGainDb +
+                                    (step + lane) * sweptGainStepDb);
+    }
+    curvessor::dbToLinear<accuracy>(Vec().load_a(db)).store_a(gain);
+    for (int lane = 0; lane < numLanes; ++lane) {
+      double const exact = std::exp(ln10 / 20.0 * db[lane]);
+      double const error = 20.0 * std::log10(gain[lane] / exact);
+      maxError = std::max(maxError, std::abs(error));
+    }
+  }
+  return maxError;
+}
+
+int
+checkGainAccuracy(FILE* out)
+{
+  using curvessor::GainAccuracy;
+
+  struct Tier
+  {
+    char const* name;
+    char const* precision;
+    double maxErrorDb;
+    double maxAllowedErrorDb;
+  };
+
+  Tier const tiers[] = {
+    { "thousandthDb",
+      "double",
+      measureGainError<GainAccuracy::thousandthDb, Vec2d>(),
+      0.001 },
+    { "thousandthDb",
+      "float",
+      measureGainError<GainAccuracy::thousandthDb, Vec4f>(),
+      0.001 },
+    { "hundredthDb",
+      "double",
+      measureGainError<GainAccuracy::hundredthDb, Vec2d>(),
+      0.01 },
+    { "hundredthDb",
+      "float",
+      measureGainError<GainAccuracy::hundredthDb, Vec4f>(),
+      0.01 },
+  };
+
+  std::fprintf(out,
+               "{\n  \"minGainDb\": %g,\n  \"maxGainDb\": %g,\n"
+               "  \"stepDb\": %g,\n  \"tiers\": [\n",
+               minSweptGainDb,
+               maxSweptGainDb,
+               sweptGainStepDb);
+
+  bool isPassing = true;
+  int const numTiers = static_cast<int>(std::size(tiers));
+  for (int i = 0; i < numTiers; ++i) {
+    auto const& tier = tiers[i];
+    bool const isAccurate = tier.maxErrorDb <= tier.maxAllowedErrorDb;
+    isPassing = isPassing && isAccurate;
+    std::fprintf(out,
+                 "    { \"accuracy\": \"%s\", \"precision\": \"%s\", "
+                 "\"maxErrorDb\": %.6f, \"maxAllowedErrorDb\": %g, "
+                 "\"pass\": %s }%s\n",
+                 tier.name,
+                 tier.precision,
+                 tier.maxErrorDb,
+                 tier.maxAllowedErrorDb,
+                 isAccurate ? "true" : "false",
+                 i + 1 < numTiers ? "," : "");
+  }
+
+  std::fprintf(
+    out, "  ],\n  \"pass\": %s\n}\n", isPassing ? "true" : "false");
+
+  return isPassing ? 0 : 1;
+}
+
+// The single precision chain against the double precision one: the same noise
+// is rendered by both, and the difference of their outputs is reported in dB
+// relative to full scale, at its peak and as an RMS.
+
+struct PrecisionResult
+{
+  double maxDifferenceDb;
+  double rmsDifferenceDb;
+};
+
+PrecisionResult
+measurePrecision(Case const& c, Settings const& settings)
+{
+  auto const render = [&](bool const isSinglePrecision) {
+    auto e = c;
+    e.isSinglePrecision = isSinglePrecision;
+    auto probe = Probe{};
+    probe.numOutputSamples =
+      static_cast<int>(settings.seconds * settings.sampleRate);
+    if (isSinglePrecision) {
+      run<float>(e, settings, &probe);
+    }
+    else {
+      run<double>(e, settings, &probe);
+    }
+    return probe.output;
+  };
+
+  auto const singlePrecision = render(true);
+  auto const doublePrecision = render(false);
+
+  auto const numSamples =
+    std::min(singlePrecision.size(), doublePrecision.size());
+  double maxDifference = 0.0;
+  double sumOfSquares = 0.0;
+  for (size_t i = 0; i < numSamples; ++i) {
+    double const difference =
+      std::abs(singlePrecision[i] - doublePrecision[i]);
+    maxDifference = std::max(maxDifference, difference);
+    sumOfSquares += difference * difference;
+  }
+  double const rmsDifference =
+    std::sqrt(sumOfSquares / std::max<size_t>(numSamples, 1));
+
+  auto const toDb = [](double const x) {
+    return 20.0 * std::log10(std::max(x, 1e-300));
+  };
+  return { toDb(maxDifference), toDb(rmsDifference) };
+}
+
+int
+printPrecision(Settings const& settings, FILE* out)
+{
+  auto cases = std::vector<Case>();
+  for (auto const topology :
+       { Topology::forward, Topology::feedback, Topology::sidechain }) {
+    for (int order = 0; order <= 2; ++order) {
+      for (bool const isUsingGainTable : { false, true }) {
+        auto c = Case{};
+        c.topology = topology;
+        c.oversamplingOrder = order;
+        c.isUsingGainTable = isUsingGainTable;
+        cases.push_back(c);
+      }
+    }
+  }
+
+  std::fprintf(out,
+               "{\n  \"sampleRate\": %g,\n  \"seconds\": %g,\n"
+               "  \"gainAccuracy\": %d,\n  \"cases\": [\n",
+               settings.sampleRate,
+               settings.seconds,
+               static_cast<int>(curvessor::gainAccuracy));
+
+  for (size_t i = 0; i < cases.size(); ++i) {
+    auto const& c = cases[i];
+    std::fprintf(stderr, "case %zu/%zu\r", i + 1, cases.size());
+    auto const r = measurePrecision(c, settings);
+    std::fprintf(out,
+                 "    { \"topology\": \"%s\", \"oversampling\": %d, "
+                 "\"gainTable\": %s, \"maxDifferenceDb\": %.1f, "
+                 "\"rmsDifferenceDb\": %.1f }%s\n",
+                 toString(c.topology),
+                 1 << c.oversamplingOrder,
+                 c.isUsingGainTable ? "true" : "false",
+                 r.maxDifferenceDb,
+                 r.rmsDifferenceDb,
+                 i + 1 < cases.size() ? "," : "");
+  }
+
+  std::fprintf(out, "  ]\n}\n");
+  std::fprintf(stderr, "\n");
+  return 0;
+}
+
+std::vector<Case>
+makeCases(bool const isFull)
+{
+  auto const precisions = { false, true };
+  auto const oversamplingOrders = { 0, 1, 2, 3, 4, 5 };
+  auto const linearPhases = { false, true };
+  auto const knotCounts = { 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+  auto const gainTables = { false, true };
+  auto const highPassOrders = { 0, 1, 2, 3 };
+  auto const topologies = { Topology::forward,
+                            Topology::feedback,
+                            Topology::sidechain };
+  auto const blockSizes = { 32, 64, 128, 256, 512, 1024 };
+  auto const detectorRates = { 0, 1, 2 };
+  auto const gainBandLimits = { false, true };
+  auto const bandCounts = { 1, 2, 3 };
+
+  // --full expands the cases with every value of each axis, otherwise each
+  // axis is varied on its own around the baseline
+  auto const baseline = Case{};
+  auto cases = std::vector<Case>{ baseline };
+
+  auto const addAxis = [&](auto const& values, auto const member) {
+    if (isFull) {
+      auto expanded = std::vector<Case>();
+      for (auto const& c : cases) {
+        for (auto value : values) {
+          auto e = c;
+          e.*member = value;
+          expanded.push_back(e);
+        }
+      }
+      cases = std::move(expanded);
+    }
+    else {
+      for (auto value : values) {
+        auto c = baseline;
+        c.*member = value;
+        if (!(c == baseline)) {
+          cases.push_back(c);
+        }
+      }
+    }
+  };
+
+  addAxis(precisions, &Case::isSinglePrecision);
+  addAxis(oversamplingOrders, &Case::oversamplingOrder);
+  addAxis(linearPhases, &Case::isLinearPhase);
+  addAxis(knotCounts, &Case::numKnots);
+  addAxis(gainTables, &Case::isUsingGainTable);
+  addAxis(highPassOrders, &Case::highPassOrder);
+  addAxis(topologies, &Case::topology);
+  addAxis(blockSizes, &Case::blockSize);
+  addAxis(detectorRates, &Case::detectorRate);
+  addAxis(gainBandLimits, &Case::isGainBandLimited);
+  addAxis(bandCounts, &Case::numBands);
+  return cases;
+}
+
+void
+printUsage()
+{
+  std::fprintf(stderr,
+               "usage: curvessor_bench [--full | --latency | --aliasing | "
+               "--precision | --gain-accuracy | --fusion] [--seconds S] "
+               "[--sample-rate R] [--output file.json]\n");
+}
+
+} // namespace
+
+int
+main(int argc, char** argv)
+{
+  auto settings = Settings{};
+  bool isFull = false;
+  bool isCheckingLatency = false;
+  bool isMeasuringAliasing = false;
+  bool isMeasuringPrecision = false;
+  bool isCheckingGainAccuracy = false;
+  bool isMeasuringFusion = false;
+  char const* outputPath = nullptr;
+
+  for (int i = 1; i < argc; ++i) {
+    auto const arg = std::string(argv[i]);
+    bool const hasValue = i + 1 < argc;
+    if (arg == "--full") {
+      isFull = true;
+    }
+    else if (arg == "--latency") {
+      isCheckingLatency = true;
+    }
+    else if (arg == "--aliasing") {
+      isMeasuringAliasing = true;
+    }
+    else if (arg == "--fusion") {
+      isMeasuringFusion = true;
+    }
+    else if (arg == "--gain-accuracy") {
+      isCheckingGainAccuracy = true;
+    }
+    else if (arg == "--precision") {
+      isMeasuringPrecision = true;
+    }
+    else if (arg == "--seconds" && hasValue) {
+      settings.seconds = std::atof(argv[++i]);
+    }
+    else if (arg == "--sample-rate" && hasValue) {
+      settings.sampleRate = std::atof(argv[++i]);
+    }
+    else if (arg == "--output" && hasValue) {
+      outputPath = argv[++i];
+    }
+    else {
+      printUsage();
+      return 1;
+    }
+  }
+
+  if (settings.seconds <= 0.0 || settings.sampleRate <= 0.0) {
+    printUsage();
+    return 1;
+  }
+
+  FILE* out = outputPath ? std::fopen(outputPath, "w") : stdout;
+  if (!out) {
+    std::fprintf(stderr, "curvessor_bench: cannot open %s\n", outputPath);
+    return 1;
+  }
+
+  if (isCheckingLatency || isMeasuringAliasing || isMeasuringPrecision ||
+      isCheckingGainAccuracy || isMeasuringFusion) {
+    int const result = isCheckingLatency        ? checkLatency(settings, out)
+                       : isMeasuringAliasing    ? printAliasing(settings, out)
+                       : isMeasuringPrecision   ? printPrecision(settings, out)
+                       : isMeasuringFusion      ? printFusion(settings, out)
+                                                : checkGainAccuracy(out);
+    if (out != stdout) {
+      std::fclose(out);
+    }
+    return result;
+  }
+
+  auto const cases = makeCases(isFull);
+
+  std::fprintf(out,
+               "{\n  \"sampleRate\": %g,\n  \"seconds\": %g,\n"
+               "  \"gainAccuracy\": %d,\n  \"cases\": [\n",
+               settings.sampleRate,
+               settings.seconds,
+               static_cast<int>(curvessor::gainAccuracy));
+
+  for (size_t i = 0; i < cases.size(); ++i) {
+    auto const& c = cases[i];
+
+    std::fprintf(stderr, "case %zu/%zu\r", i + 1, cases.size());
+
+    auto const r = c.isSinglePrecision ? run<float>(c, settings)
+                                       : run<double>(c, settings);
+
+    std::fprintf(
+      out,
+      "    { \"precision\": \"%s\", \"oversampling\": %d, "
+      "\"linearPhase\": %s, \"knots\": %d, \"gainTable\": %s, "
+      "\"highPassOrder\": %d, \"topology\": \"%s\", \"blockSize\": %d, "
+      "\"detectorRate\": \"%s\", \"bandLimitedGain\": %s, \"bands\": %d, "
+      "\"nsPerSample\": %.3f, \"realTimeFactor\": %.2f, "
+      "\"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f }%s\n",
+      c.isSinglePrecision ? "float" : "double",
+      1 << c.oversamplingOrder,
+      c.isLinearPhase ? "true" : "false",
+      c.numKnots,
+      c.isUsingGainTable ? "true" : "false",
+      c.highPassOrder,
+      toString(c.topology),
+      c.blockSize,
+      toDetectorRateString(c.detectorRate),
+      c.isGainBandLimited ? "true" : "false",
+      c.numBands,
+      r.nsPerSample,
+      r.realTimeFactor,
+      r.p50,
+      r.p90,
+      r.p99,
+      r.max,
+      i + 1 < cases.size() ? "," : "");
+  }
+
+  std::fprintf(out, "  ]\n}\n");
+  std::fprintf(stderr, "\n");
+
+  if (out != stdout) {
+    std::fclose(out);
+  }
+  return 0;
+}
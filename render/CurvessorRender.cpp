@@ -0,0 +1,370 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Curvessor.
+
+Curvessor is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Curvessor is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Curvessor.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Offline rendering of audio files through CurvessorAudioProcessor, without a
+// host. Every input file is streamed through the processor in blocks of
+// --block-size samples, with the latency compensated so that the output lines
+// up with the input and has the same length, and written to --output-dir with
+// the same name, in the format of --format or else of the input. Nothing is
+// rendered if an output would overwrite an input or another output.
+//
+// The preset is either the binary state the plug-in gives its host, as saved
+// by the standalone app, or the XML of the parameters in it. The sidechain
+// and the gain link are turned off, as files have no sidechain and the
+// instances rendering in parallel must not link to each other.
+//
+// The files are rendered in parallel by a WorkStealingScheduler, a file per
+// job, dealt to the workers largest first. Each worker is pinned to a CPU and
+// has its own processor, made, prepared and run on the worker thread, so that
+// its Dsp, oversamplers and buffers are allocated on the NUMA node of the CPU
+// and stay in its caches from a file to the next. By default there is a
+// worker per physical core. The processors are made and destroyed under a
+// MessageManagerLock, while the main thread runs the message loop. Files with
+// 1 to 8 channels are supported, mono ones are processed as dual mono.
+//
+// usage: curvessor_render --preset file --output-dir dir [--format wav|flac]
+//                         [--jobs N] [--block-size B] input...
+
+#include "PluginProcessor.h"
+#include "WorkStealingScheduler.h"
+#include <JuceHeader.h>
+#include <cstdio>
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+
+namespace {
+
+struct Options
+{
+  File preset;
+  File outputDirectory;
+  String format;
+  int numJobs = SystemStats::getNumPhysicalCpus();
+  int blockSize = 8192;
+  Array<File> inputs;
+};
+
+void
+printUsage()
+{
+  std::fprintf(stderr,
+               "usage: curvessor_render --preset file --output-dir dir "
+               "[--format wav|flac] [--jobs N] [--block-size B] input...\n");
+}
+
+// the Xml of a preset, binary or not, or null if it is not a Curvessor one
+std::unique_ptr<XmlElement>
+loadPreset(File const& file, Identifier const& type)
+{
+  MemoryBlock data;
+  if (!file.loadFileAsData(data)) {
+    return nullptr;
+  }
+  std::unique_ptr<XmlElement> xml(AudioProcessor::getXmlFromBinary(
+    data.getData(), static_cast<int>(data.getSize())));
+  if (!xml) {
+    xml = XmlDocument::parse(data.toString());
+  }
+  if (!xml || !xml->hasTagName(type)) {
+    return nullptr;
+  }
+  return xml;
+}
+
+void
+applyPreset(XmlElement const& preset, CurvessorAudioProcessor& processor)
+{
+  MemoryBlock state;
+  AudioProcessor::copyXmlToBinary(preset, state);
+  processor.setStateInformation(state.getData(),
+                                static_cast<int>(state.getSize()));
+
+  auto& parameters = processor.getCurvessorParameters();
+  *parameters.sideChain = false;
+  *parameters.gainLink = 0;
+}
+
+// where input is rendered to: its name in the output directory, with the
+// extension of --format if any
+File
+getOutputFile(Options const& options, File const& input)
+{
+  auto const extension = options.format.isEmpty() ? input.getFileExtension()
+                                                  : "." + options.format;
+  return options.outputDirectory.getChildFile(
+    input.getFileNameWithoutExtension() + extension);
+}
+
+// Renders input to output. Returns an error message, empty on success.
+String
+render(CurvessorAudioProcessor& processor,
+       AudioFormatManager& formats,
+       File const& input,
+       File const& output,
+       AudioFormat& outputFormat,
+       int const blockSize)
+{
+  std::unique_ptr<AudioFormatReader> reader(formats.createReaderFor(input));
+  if (!reader) {
+    return "cannot read " + input.getFullPathName();
+  }
+
+  int const numFileChannels = static_cast<int>(reader->numChannels);
+  if (numFileChannels < 1 || numFileChannels > 8) {
+    return "unsupported number of channels in " + input.getFullPathName();
+  }
+  int const numChannels = jmax(2, numFileChannels);
+
+  // the main bus follows the file, the sidechain bus is left out
+  auto layout = processor.getBusesLayout();
+  auto const channelSet = AudioChannelSet::canonicalChannelSet(numChannels);
+  layout.inputBuses.getReference(0) = channelSet;
+  layout.outputBuses.getReference(0) = channelSet;
+  for (int bus = 1; bus < layout.inputBuses.size(); ++bus) {
+    layout.inputBuses.getReference(bus) = AudioChannelSet::disabled();
+  }
+
+  processor.releaseResources();
+  if (!processor.setBusesLayout(layout)) {
+    return "unsupported channel layout in " + input.getFullPathName();
+  }
+
+  double const sampleRate = reader->sampleRate;
+  processor.setNonRealtime(true);
+  processor.setRateAndBufferSizeDetails(sampleRate, blockSize);
+  processor.prepareToPlay(sampleRate, blockSize);
+
+  auto const bitDepths = outputFormat.getPossibleBitDepths();
+  int const bitsPerSample = bitDepths.contains(reader->bitsPerSample)
+                              ? reader->bitsPerSample
+                              : bitDepths.getLast();
+
+  output.deleteFile();
+  auto stream = output.createOutputStream();
+  if (!stream) {
+    return "cannot write " + output.getFullPathName();
+  }
+  std::unique_ptr<AudioFormatWriter> writer(
+    outputFormat.createWriterFor(stream.get(),
+                                 sampleRate,
+                                 static_cast<unsigned>(numFileChannels),
+                                 bitsPerSample,
+                                 reader->metadataValues,
+                                 0));
+  if (!writer) {
+    return "cannot write " + output.getFullPathName() + " in this format";
+  }
+  // owned by the writer from now on
+  stream.release();
+
+  // the first latency samples of the output are dropped, and as many
+  // samples of silence are fed past the end of the input
+  int64 const length = reader->lengthInSamples;
+  int64 toSkip = processor.getLatencySamples();
+  int64 readPosition = 0;
+  int64 numWritten = 0;
+
+  AudioBuffer<float> buffer(jmax(processor.getTotalNumInputChannels(),
+                                 processor.getTotalNumOutputChannels()),
+                            blockSize);
+  MidiBuffer midi;
+
+  while (numWritten < length) {
+    buffer.clear();
+
+    int const numRead =
+      static_cast<int>(jlimit<int64>(0, blockSize, length - readPosition));
+    if (numRead > 0) {
+      reader->read(&buffer, 0, numRead, readPosition, true, true);
+      if (numFileChannels == 1) {
+        buffer.copyFrom(1, 0, buffer, 0, 0, numRead);
+      }
+      readPosition += numRead;
+    }
+
+    processor.processBlock(buffer, midi);
+
+    int const skip = static_cast<int>(jmin<int64>(toSkip, blockSize));
+    toSkip -= skip;
+    int const numToWrite =
+      static_cast<int>(jmin<int64>(blockSize - skip, length - numWritten));
+    if (numToWrite > 0 &&
+        !writer->writeFromAudioSampleBuffer(buffer, skip, numToWrite)) {
+      return "cannot write " + output.getFullPathName();
+    }
+    numWritten += jmax(numToWrite, 0);
+  }
+
+  return {};
+}
+
+} // namespace
+
+int
+main(int argc, char** argv)
+{
+  auto options = Options{};
+
+  for (int i = 1; i < argc; ++i) {
+    auto const arg = std::string(argv[i]);
+    bool const hasValue = i + 1 < argc;
+    if (arg == "--preset" && hasValue) {
+      options.preset = File::getCurrentWorkingDirectory().getChildFile(
+        String::fromUTF8(argv[++i]));
+    }
+    else if (arg == "--output-dir" && hasValue) {
+      options.outputDirectory =
+        File::getCurrentWorkingDirectory().getChildFile(
+          String::fromUTF8(argv[++i]));
+    }
+    else if (arg == "--format" && hasValue) {
+      options.format = String::fromUTF8(argv[++i]).toLowerCase();
+    }
+    else if (arg == "--jobs" && hasValue) {
+      options.numJobs = std::atoi(argv[++i]);
+    }
+    else if (arg == "--block-size" && hasValue) {
+      options.blockSize = std::atoi(argv[++i]);
+    }
+    else if (arg.rfind("--", 0) != 0) {
+      options.inputs.add(File::getCurrentWorkingDirectory().getChildFile(
+        String::fromUTF8(argv[i])));
+    }
+    else {
+      printUsage();
+      return 1;
+    }
+  }
+
+  if (options.preset == File() || options.outputDirectory == File() ||
+      options.inputs.isEmpty() || options.numJobs < 1 ||
+      options.blockSize < 1 ||
+      !(options.format.isEmpty() || options.format == "wav" ||
+        options.format == "flac")) {
+    printUsage();
+    return 1;
+  }
+
+  // the processors and their parameters need the message manager
+  ScopedJuceInitialiser_GUI const juceInitialiser;
+
+  if (!options.outputDirectory.createDirectory()) {
+    std::fprintf(stderr,
+                 "curvessor_render: cannot create %s\n",
+                 options.outputDirectory.getFullPathName().toRawUTF8());
+    return 1;
+  }
+
+  std::unique_ptr<XmlElement> preset;
+  {
+    auto const type = CurvessorAudioProcessor{}
+                        .getCurvessorParameters()
+                        .apvts->state.getType();
+    preset = loadPreset(options.preset, type);
+  }
+  if (!preset) {
+    std::fprintf(stderr,
+                 "curvessor_render: %s is not a Curvessor preset\n",
+                 options.preset.getFullPathName().toRawUTF8());
+    return 1;
+  }
+
+  // an output must neither overwrite an input, which may be still being
+  // read, nor be written by two jobs at once
+  Array<File> outputs;
+  for (auto const& input : options.inputs) {
+    auto const output = getOutputFile(options, input);
+    char const* const error =
+      options.inputs.contains(output) ? "would overwrite the input"
+      : outputs.contains(output)      ? "would be written twice"
+                                      : nullptr;
+    if (error) {
+      std::fprintf(stderr,
+                   "curvessor_render: %s %s\n",
+                   output.getFullPathName().toRawUTF8(),
+                   error);
+      return 1;
+    }
+    outputs.add(output);
+  }
+
+  AudioFormatManager formats;
+  formats.registerBasicFormats();
+
+  // largest first, so that the last jobs are short ones
+  auto inputs = options.inputs;
+  std::stable_sort(
+    inputs.begin(), inputs.end(), [](File const& a, File const& b) {
+      return a.getSize() > b.getSize();
+    });
+
+  int const numWorkers = jmin(options.numJobs, inputs.size());
+  std::vector<std::unique_ptr<CurvessorAudioProcessor>> processors(
+    static_cast<size_t>(numWorkers));
+  std::atomic<int> numFailures{ 0 };
+
+  curvessor::WorkStealingScheduler scheduler(numWorkers);
+
+  for (int i = 0; i < inputs.size(); ++i) {
+    scheduler.add(i % numWorkers, [&, input = inputs[i]](int const worker) {
+      auto const output = getOutputFile(options, input);
+      auto* format =
+        formats.findFormatForFileExtension(output.getFileExtension());
+
+      auto const error =
+        format ? render(*processors[static_cast<size_t>(worker)],
+                        formats,
+                        input,
+                        output,
+                        *format,
+                        options.blockSize)
+               : "no format to write " + output.getFullPathName();
+
+      if (error.isEmpty()) {
+        std::fprintf(
+          stderr, "rendered %s\n", output.getFullPathName().toRawUTF8());
+      }
+      else {
+        std::fprintf(stderr, "curvessor_render: %s\n", error.toRawUTF8());
+        ++numFailures;
+      }
+    });
+  }
+
+  scheduler.start(
+    [&](int const worker) {
+      MessageManagerLock const lock;
+      auto& processor = processors[static_cast<size_t>(worker)];
+      processor = std::make_unique<CurvessorAudioProcessor>();
+      applyPreset(*preset, *processor);
+    },
+    [&](int const worker) {
+      MessageManagerLock const lock;
+      processors[static_cast<size_t>(worker)].reset();
+    });
+
+  // the workers need the message loop to take their MessageManagerLock
+  while (!scheduler.isFinished()) {
+    MessageManager::getInstance()->runDispatchLoopUntil(10);
+  }
+  scheduler.wait();
+
+  return numFailures.load() == 0 ? 0 : 1;
+}
@@ -0,0 +1,267 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Curvessor.
+
+Curvessor is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Curvessor is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Curvessor.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Kept out of CurvessorRender.cpp so that the OS headers stay away from
+// JuceHeader.h.
+
+#include "WorkStealingScheduler.h"
+#include <algorithm>
+#include <cstdint>
+
+#if defined(__linux__)
+#include <fstream>
+#include <pthread.h>
+#include <sched.h>
+#include <string>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+namespace curvessor {
+
+namespace {
+
+// Moves the CPUs sharing a core with an earlier one to the end. cores[i]
+// identifies the core of cpus[i].
+std::vector<int>
+orderByCore(std::vector<int> const& cpus, std::vector<int64_t> const& cores)
+{
+  std::vector<int> ordered;
+  std::vector<int> siblings;
+  std::vector<int64_t> seenCores;
+  for (size_t i = 0; i < cpus.size(); ++i) {
+    if (std::find(seenCores.begin(), seenCores.end(), cores[i]) ==
+        seenCores.end()) {
+      seenCores.push_back(cores[i]);
+      ordered.push_back(cpus[i]);
+    }
+    else {
+      siblings.push_back(cpus[i]);
+    }
+  }
+  ordered.insert(ordered.end(), siblings.begin(), siblings.end());
+  return ordered;
+}
+
+#if defined(__linux__)
+
+// a value of /sys/devices/system/cpu/cpuN/topology, -1 if unknown
+int64_t
+readTopology(int const cpu, char const* name)
+{
+  auto file = std::ifstream("/sys/devices/system/cpu/cpu" +
+                            std::to_string(cpu) + "/topology/" + name);
+  int64_t value = -1;
+  if (!(file >> value)) {
+    return -1;
+  }
+  return value;
+}
+
+#endif
+
+} // namespace
+
+std::vector<int>
+getWorkerCpus()
+{
+  std::vector<int> cpus;
+  std::vector<int64_t> cores;
+#if defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (!CPU_ISSET(cpu, &set)) {
+        continue;
+      }
+      int64_t const package = readTopology(cpu, "physical_package_id");
+      int64_t const core = readTopology(cpu, "core_id");
+      cpus.push_back(cpu);
+      // a CPU of unknown topology counts as a core of its own
+      cores.push_back(package < 0 || core < 0 ? -1 - cpu
+                                              : (package << 32) | core);
+    }
+  }
+#elif defined(_WIN32)
+  // the processor group of the process, up to 64 CPUs
+  DWORD_PTR processMask = 0;
+  DWORD_PTR systemMask = 0;
+  GROUP_AFFINITY threadAffinity = {};
+  if (!GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask) ||
+      !GetThreadGroupAffinity(GetCurrentThread(), &threadAffinity)) {
+    return cpus;
+  }
+
+  constexpr int maxNumCpus = static_cast<int>(8 * sizeof(DWORD_PTR));
+  int64_t coreOfCpu[maxNumCpus];
+  for (int cpu = 0; cpu < maxNumCpus; ++cpu) {
+    coreOfCpu[cpu] = -1 - cpu;
+  }
+
+  DWORD length = 0;
+  GetLogicalProcessorInformationEx(RelationProcessorCore, nullptr, &length);
+  std::vector<char> buffer(length);
+  auto* info =
+    reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer.data());
+  if (length > 0 &&
+      GetLogicalProcessorInformationEx(RelationProcessorCore, info, &length)) {
+    int64_t core = 0;
+    for (DWORD offset = 0; offset < length; ++core) {
+      auto const& entry =
+        *reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX const*>(
+          buffer.data() + offset);
+      for (WORD g = 0; g < entry.Processor.GroupCount; ++g) {
+        auto const& groupMask = entry.Processor.GroupMask[g];
+        if (groupMask.Group != threadAffinity.Group) {
+          continue;
+        }
+        for (int cpu = 0; cpu < maxNumCpus; ++cpu) {
+          if ((groupMask.Mask >> cpu) & 1) {
+            coreOfCpu[cpu] = core;
+          }
+        }
+      }
+      offset += entry.Size;
+    }
+  }
+
+  for (int cpu = 0; cpu < maxNumCpus; ++cpu) {
+    if ((processMask >> cpu) & 1) {
+      cpus.push_back(cpu);
+      cores.push_back(coreOfCpu[cpu]);
+    }
+  }
+#endif
+  return orderByCore(cpus, cores);
+}
+
+bool
+pinCurrentThread(int const cpu)
+{
+#if defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#elif defined(_WIN32)
+  auto const mask = static_cast<DWORD_PTR>(1) << cpu;
+  return SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#else
+  (void)cpu;
+  return false;
+#endif
+}
+
+WorkStealingScheduler::WorkStealingScheduler(int const numWorkers)
+  : cpus(getWorkerCpus())
+{
+  for (int i = 0; i < numWorkers; ++i) {
+    workers.push_back(std::make_unique<Worker>());
+  }
+}
+
+WorkStealingScheduler::~WorkStealingScheduler()
+{
+  wait();
+}
+
+void
+WorkStealingScheduler::add(int const worker, Job job)
+{
+  auto& w = *workers[worker];
+  std::lock_guard<std::mutex> const lock(w.mutex);
+  w.jobs.push_back(std::move(job));
+}
+
+void
+WorkStealingScheduler::start(WorkerCallback onStart_, WorkerCallback onFinish_)
+{
+  onStart = std::move(onStart_);
+  onFinish = std::move(onFinish_);
+  numRunningWorkers.store(getNumWorkers());
+  for (int i = 0; i < getNumWorkers(); ++i) {
+    workers[i]->thread = std::thread([this, i] { run(i); });
+  }
+}
+
+void
+WorkStealingScheduler::wait()
+{
+  for (auto& worker : workers) {
+    if (worker->thread.joinable()) {
+      worker->thread.join();
+    }
+  }
+}
+
+bool
+WorkStealingScheduler::pop(int const worker, Job& job)
+{
+  auto& w = *workers[worker];
+  std::lock_guard<std::mutex> const lock(w.mutex);
+  if (w.jobs.empty()) {
+    return false;
+  }
+  job = std::move(w.jobs.front());
+  w.jobs.pop_front();
+  return true;
+}
+
+bool
+WorkStealingScheduler::steal(int const thief, Job& job)
+{
+  int const numWorkers = getNumWorkers();
+  for (int k = 1; k < numWorkers; ++k) {
+    auto& victim = *workers[(thief + k) % numWorkers];
+    std::lock_guard<std::mutex> const lock(victim.mutex);
+    if (!victim.jobs.empty()) {
+      job = std::move(victim.jobs.back());
+      victim.jobs.pop_back();
+      return true;
+    }
+  }
+  return false;
+}
+
+void
+WorkStealingScheduler::run(int const worker)
+{
+  if (!cpus.empty()) {
+    pinCurrentThread(cpus[worker % cpus.size()]);
+  }
+
+  if (onStart) {
+    onStart(worker);
+  }
+
+  Job job;
+  while (pop(worker, job) || steal(worker, job)) {
+    job(worker);
+    job = nullptr;
+  }
+
+  if (onFinish) {
+    onFinish(worker);
+  }
+
+  --numRunningWorkers;
+}
+
+} // namespace curvessor
@@ -0,0 +1,107 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Curvessor.
+
+Curvessor is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Curvessor is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Curvessor.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// The scheduler of curvessor_render, see CurvessorRender.cpp. JUCE-free.
+//
+// Each worker is a thread pinned to its own CPU, with a deque of jobs. It runs
+// the jobs of its deque from the front, and when it runs out it steals from
+// the back of the deques of the others, starting from the next worker. All
+// the jobs are added before the start, so a worker that finds every deque
+// empty is done.
+//
+// onStart is called on each worker thread once it is pinned, before its first
+// job, so that the state of the worker is made there: with the first touch
+// policy of Linux and Windows its memory then comes from the NUMA node of the
+// CPU, and it stays in the caches of that CPU between the jobs. onFinish is
+// called on the same thread after the last one.
+//
+// The CPUs are the ones the process may run on, one per physical core first,
+// then the other hardware threads of the cores, so that the workers get a
+// core each as long as there are enough. The cores are read from the
+// topology the OS reports, as sibling hardware threads are not numbered the
+// same way on every system. Where pinning is not supported, as on macOS, the
+// workers are left to the OS.
+//
+// The jobs are coarse, whole files, so the deques are guarded by a mutex
+// each, taken once per job.
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace curvessor {
+
+// the CPUs the process may run on, one per physical core first, empty if
+// unknown
+std::vector<int>
+getWorkerCpus();
+
+// pins the calling thread to a CPU, false if it could not
+bool
+pinCurrentThread(int cpu);
+
+class WorkStealingScheduler final
+{
+public:
+  using Job = std::function<void(int worker)>;
+  using WorkerCallback = std::function<void(int worker)>;
+
+  explicit WorkStealingScheduler(int numWorkers);
+
+  // waits for the workers
+  ~WorkStealingScheduler();
+
+  int getNumWorkers() const { return static_cast<int>(workers.size()); }
+
+  // adds a job to the deque of a worker, only before start
+  void add(int worker, Job job);
+
+  void start(WorkerCallback onStart, WorkerCallback onFinish);
+
+  // true once every worker has returned from onFinish
+  bool isFinished() const { return numRunningWorkers.load() == 0; }
+
+  void wait();
+
+private:
+  struct Worker
+  {
+    std::mutex mutex;
+    std::deque<Job> jobs;
+    std::thread thread;
+  };
+
+  bool pop(int worker, Job& job);
+  bool steal(int thief, Job& job);
+  void run(int worker);
+
+  std::vector<std::unique_ptr<Worker>> workers;
+  std::vector<int> cpus;
+  WorkerCallback onStart;
+  WorkerCallback onFinish;
+  std::atomic<int> numRunningWorkers{ 0 };
+};
+
+} // namespace curvessor